@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// A file, or stdout, written through one large buffer, so many small writes
+// turn into a few big sequential ones
+class BufferedOutput
+{
+public:
+	static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+	// filename "-" writes to stdout
+	BufferedOutput(const char *filename)
+	{
+		m_error = false;
+
+		if (strcmp(filename, "-") == 0)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			m_file = stdout;
+			m_ownsFile = false;
+		}
+		else
+		{
+			m_file = fopen(filename, "wb");
+			m_ownsFile = true;
+		}
+
+		if (!m_file)
+			m_error = true;
+
+		m_buffer.reserve(BUFFER_SIZE);
+	}
+
+	~BufferedOutput()
+	{
+		close();
+	}
+
+	BufferedOutput(const BufferedOutput&) = delete;
+	BufferedOutput& operator=(const BufferedOutput&) = delete;
+
+	inline void write(const char *data, size_t size)
+	{
+		if (m_buffer.size() + size > BUFFER_SIZE)
+		{
+			flush();
+
+			if (size >= BUFFER_SIZE)
+			{
+				writeFile(data, size);
+				return;
+			}
+		}
+
+		m_buffer.insert(m_buffer.end(), data, data + size);
+	}
+
+	inline void put(char c)
+	{
+		if (m_buffer.size() == BUFFER_SIZE)
+			flush();
+
+		m_buffer.push_back(c);
+	}
+
+	// Appends `count` copies of `c`
+	inline void fill(char c, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			put(c);
+	}
+
+	// Flushes and closes the file. Returns false if anything couldn't be written.
+	bool close()
+	{
+		if (!m_file)
+			return !m_error;
+
+		flush();
+
+		if (m_ownsFile)
+		{
+			if (fclose(m_file) != 0)
+				m_error = true;
+		}
+		else if (fflush(m_file) != 0)
+			m_error = true;
+
+		m_file = nullptr;
+		return !m_error;
+	}
+
+	bool hasError() const
+	{
+		return m_error;
+	}
+
+private:
+	FILE *m_file;
+	bool m_ownsFile;
+	bool m_error;
+	std::vector<char> m_buffer;
+
+	void flush()
+	{
+		writeFile(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+
+	void writeFile(const char *data, size_t size)
+	{
+		if (m_error || size == 0)
+			return;
+
+		if (fwrite(data, 1, size, m_file) != size)
+			m_error = true;
+	}
+};
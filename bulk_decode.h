@@ -0,0 +1,396 @@
+#pragma once
+
+#include "elf.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Bulk decoders for the fixed-layout tables (.symtab entries and .line
+// records). Instead of calling ElfFile::read<> per field, which checks the
+// endianness on every call, these byte-swap and transpose whole tables into
+// structure-of-arrays columns. SSE2 and AVX2 kernels are selected at runtime,
+// with a scalar fallback for everything else.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define BULK_DECODE_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define BULK_TARGET_AVX2
+	#else
+		#define BULK_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace BulkDecode
+{
+enum Isa
+{
+	ISA_SCALAR = 0,
+	ISA_SSE2,
+	ISA_AVX2
+};
+
+// Size of one .line record: line number (4), character offset (2), address offset (4)
+static const size_t LINE_RECORD_SIZE = 10;
+
+// Column pointers the symbol kernels write into. Every column must have room for `count` values.
+struct SymbolColumns
+{
+	Elf32_Word *name;
+	Elf32_Addr *value;
+	Elf32_Word *size;
+	unsigned char *info;
+	Elf32_Half *shndx;
+};
+
+// Column pointers the line record kernels write into.
+struct LineColumns
+{
+	int *lineNumber;
+	short *charOffset;
+	int *addressOffset;
+};
+
+inline Isa detectIsa()
+{
+#ifdef BULK_DECODE_X86
+	#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	int maxLeaf = regs[0];
+
+	__cpuid(regs, 1);
+	bool sse2 = (regs[3] & (1 << 26)) != 0;
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(regs, 7, 0);
+
+		if (regs[1] & (1 << 5))
+			return ISA_AVX2;
+	}
+
+	return sse2 ? ISA_SSE2 : ISA_SCALAR;
+	#else
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return ISA_AVX2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return ISA_SSE2;
+	#endif
+#endif
+
+	return ISA_SCALAR;
+}
+
+// The detected instruction set, cached after the first call
+inline Isa getIsa()
+{
+	static const Isa isa = detectIsa();
+	return isa;
+}
+
+inline uint32_t load32(const unsigned char *p, bool swap)
+{
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return swap ? swap4(x) : x;
+}
+
+inline uint16_t load16(const unsigned char *p, bool swap)
+{
+	uint16_t x;
+	memcpy(&x, p, sizeof(x));
+	return swap ? (uint16_t)swap2(x) : x;
+}
+
+// Splits the last word of an Elf32_Sym (st_info, st_other, st_shndx) after the
+// word has been loaded with the same swap as the other three fields. Which end
+// of the word holds st_info depends on the host, and this assumes a
+// little-endian one, like ElfFile::initEndian, which never swaps on others.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "splitSymbolMisc expects a little-endian host");
+#endif
+
+inline void splitSymbolMisc(uint32_t misc, bool swap, unsigned char *info, Elf32_Half *shndx)
+{
+	if (swap)
+	{
+		*info = (unsigned char)(misc >> 24);
+		*shndx = (Elf32_Half)(misc & 0xffff);
+	}
+	else
+	{
+		*info = (unsigned char)(misc & 0xff);
+		*shndx = (Elf32_Half)(misc >> 16);
+	}
+}
+
+template<bool Swap>
+inline void decodeSymbolsScalar(const unsigned char *data, size_t begin, size_t count, const SymbolColumns &out)
+{
+	for (size_t i = begin; i < count; i++)
+	{
+		const unsigned char *sym = data + i * sizeof(Elf32_Sym);
+
+		out.name[i] = load32(sym, Swap);
+		out.value[i] = load32(sym + 4, Swap);
+		out.size[i] = load32(sym + 8, Swap);
+		splitSymbolMisc(load32(sym + 12, Swap), Swap, &out.info[i], &out.shndx[i]);
+	}
+}
+
+template<bool Swap>
+inline void decodeLinesScalar(const unsigned char *data, size_t begin, size_t count, const LineColumns &out)
+{
+	for (size_t i = begin; i < count; i++)
+	{
+		const unsigned char *rec = data + i * LINE_RECORD_SIZE;
+
+		out.lineNumber[i] = (int)load32(rec, Swap);
+		out.charOffset[i] = (short)load16(rec + 4, Swap);
+		out.addressOffset[i] = (int)load32(rec + 6, Swap);
+	}
+}
+
+#ifdef BULK_DECODE_X86
+// Reverses the bytes of each 32-bit lane: swap the bytes of each 16-bit half, then swap the halves
+inline __m128i byteSwap32Sse2(__m128i x)
+{
+	x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+inline __m128i byteSwap16Sse2(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+// Four symbols per iteration: load the 4x4 words, swap, and transpose into columns
+template<bool Swap>
+inline void decodeSymbolsSse2(const unsigned char *data, size_t count, const SymbolColumns &out)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i *sym = (const __m128i*)(data + i * sizeof(Elf32_Sym));
+
+		__m128i r0 = _mm_loadu_si128(sym);
+		__m128i r1 = _mm_loadu_si128(sym + 1);
+		__m128i r2 = _mm_loadu_si128(sym + 2);
+		__m128i r3 = _mm_loadu_si128(sym + 3);
+
+		if (Swap)
+		{
+			r0 = byteSwap32Sse2(r0);
+			r1 = byteSwap32Sse2(r1);
+			r2 = byteSwap32Sse2(r2);
+			r3 = byteSwap32Sse2(r3);
+		}
+
+		__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+		__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+		__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+		__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+		_mm_storeu_si128((__m128i*)(out.name + i), _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128((__m128i*)(out.value + i), _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128((__m128i*)(out.size + i), _mm_unpacklo_epi64(t2, t3));
+
+		uint32_t misc[4];
+		_mm_storeu_si128((__m128i*)misc, _mm_unpackhi_epi64(t2, t3));
+
+		for (int j = 0; j < 4; j++)
+			splitSymbolMisc(misc[j], Swap, &out.info[i + j], &out.shndx[i + j]);
+	}
+
+	decodeSymbolsScalar<Swap>(data, i, count, out);
+}
+
+// Four records per iteration. Each record is loaded as 16 bytes and shifted so
+// that the field of interest sits in the low word, then the columns are
+// gathered with the same unpack transpose as the symbols. The loop stops early
+// enough that the 16-byte loads never read past `available` bytes.
+template<bool Swap>
+inline void decodeLinesSse2(const unsigned char *data, size_t count, size_t available, const LineColumns &out)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count && (i + 3) * LINE_RECORD_SIZE + 16 <= available; i += 4)
+	{
+		const unsigned char *rec = data + i * LINE_RECORD_SIZE;
+
+		__m128i r0 = _mm_loadu_si128((const __m128i*)rec);
+		__m128i r1 = _mm_loadu_si128((const __m128i*)(rec + LINE_RECORD_SIZE));
+		__m128i r2 = _mm_loadu_si128((const __m128i*)(rec + LINE_RECORD_SIZE * 2));
+		__m128i r3 = _mm_loadu_si128((const __m128i*)(rec + LINE_RECORD_SIZE * 3));
+
+		__m128i lines = _mm_unpacklo_epi64(_mm_unpacklo_epi32(r0, r1), _mm_unpacklo_epi32(r2, r3));
+
+		__m128i chars = _mm_unpacklo_epi64(
+			_mm_unpacklo_epi32(_mm_srli_si128(r0, 4), _mm_srli_si128(r1, 4)),
+			_mm_unpacklo_epi32(_mm_srli_si128(r2, 4), _mm_srli_si128(r3, 4)));
+
+		__m128i addrs = _mm_unpacklo_epi64(
+			_mm_unpacklo_epi32(_mm_srli_si128(r0, 6), _mm_srli_si128(r1, 6)),
+			_mm_unpacklo_epi32(_mm_srli_si128(r2, 6), _mm_srli_si128(r3, 6)));
+
+		if (Swap)
+		{
+			lines = byteSwap32Sse2(lines);
+			chars = byteSwap16Sse2(chars);
+			addrs = byteSwap32Sse2(addrs);
+		}
+
+		// Sign-extend the low half of each lane, then narrow to 16 bits
+		chars = _mm_srai_epi32(_mm_slli_epi32(chars, 16), 16);
+		chars = _mm_packs_epi32(chars, chars);
+
+		_mm_storeu_si128((__m128i*)(out.lineNumber + i), lines);
+		_mm_storel_epi64((__m128i*)(out.charOffset + i), chars);
+		_mm_storeu_si128((__m128i*)(out.addressOffset + i), addrs);
+	}
+
+	decodeLinesScalar<Swap>(data, i, count, out);
+}
+
+BULK_TARGET_AVX2 inline __m256i byteSwap32Avx2(__m256i x)
+{
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	return _mm256_shuffle_epi8(x, mask);
+}
+
+// Eight symbols per iteration. The unpack transpose works within each 128-bit
+// lane, so the columns come out as (0, 2, 4, 6 | 1, 3, 5, 7) and a final
+// cross-lane permute restores symbol order.
+template<bool Swap>
+BULK_TARGET_AVX2 inline void decodeSymbolsAvx2(const unsigned char *data, size_t count, const SymbolColumns &out)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i *sym = (const __m256i*)(data + i * sizeof(Elf32_Sym));
+
+		__m256i r0 = _mm256_loadu_si256(sym);
+		__m256i r1 = _mm256_loadu_si256(sym + 1);
+		__m256i r2 = _mm256_loadu_si256(sym + 2);
+		__m256i r3 = _mm256_loadu_si256(sym + 3);
+
+		if (Swap)
+		{
+			r0 = byteSwap32Avx2(r0);
+			r1 = byteSwap32Avx2(r1);
+			r2 = byteSwap32Avx2(r2);
+			r3 = byteSwap32Avx2(r3);
+		}
+
+		__m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+		__m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+		__m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+		__m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+
+		_mm256_storeu_si256((__m256i*)(out.name + i), _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t0, t1), order));
+		_mm256_storeu_si256((__m256i*)(out.value + i), _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t0, t1), order));
+		_mm256_storeu_si256((__m256i*)(out.size + i), _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t2, t3), order));
+
+		uint32_t misc[8];
+		_mm256_storeu_si256((__m256i*)misc, _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t2, t3), order));
+
+		for (int j = 0; j < 8; j++)
+			splitSymbolMisc(misc[j], Swap, &out.info[i + j], &out.shndx[i + j]);
+	}
+
+	decodeSymbolsScalar<Swap>(data, i, count, out);
+}
+
+// Eight records per iteration using byte-offset gathers. Each gather reads
+// 4 bytes from inside its record, so nothing past the last record is touched.
+template<bool Swap>
+BULK_TARGET_AVX2 inline void decodeLinesAvx2(const unsigned char *data, size_t count, const LineColumns &out)
+{
+	const __m256i index = _mm256_setr_epi32(0, 10, 20, 30, 40, 50, 60, 70);
+	const __m256i swap16 = _mm256_setr_epi8(
+		1, 0, 2, 3, 5, 4, 6, 7, 9, 8, 10, 11, 13, 12, 14, 15,
+		1, 0, 2, 3, 5, 4, 6, 7, 9, 8, 10, 11, 13, 12, 14, 15);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const int *rec = (const int*)(data + i * LINE_RECORD_SIZE);
+
+		__m256i lines = _mm256_i32gather_epi32(rec, index, 1);
+		__m256i chars = _mm256_i32gather_epi32((const int*)((const char*)rec + 4), index, 1);
+		__m256i addrs = _mm256_i32gather_epi32((const int*)((const char*)rec + 6), index, 1);
+
+		if (Swap)
+		{
+			lines = byteSwap32Avx2(lines);
+			chars = _mm256_shuffle_epi8(chars, swap16);
+			addrs = byteSwap32Avx2(addrs);
+		}
+
+		chars = _mm256_srai_epi32(_mm256_slli_epi32(chars, 16), 16);
+
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(chars), _mm256_extracti128_si256(chars, 1));
+
+		_mm256_storeu_si256((__m256i*)(out.lineNumber + i), lines);
+		_mm_storeu_si128((__m128i*)(out.charOffset + i), packed);
+		_mm256_storeu_si256((__m256i*)(out.addressOffset + i), addrs);
+	}
+
+	decodeLinesScalar<Swap>(data, i, count, out);
+}
+#endif
+
+// Decodes `count` consecutive Elf32_Sym entries into `out`. `isa` selects the
+// kernel and must not be above getIsa().
+inline void decodeSymbols(const void *data, size_t count, bool swap, const SymbolColumns &out, Isa isa = getIsa())
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+
+	switch (isa)
+	{
+#ifdef BULK_DECODE_X86
+	case ISA_AVX2:
+		return swap ? decodeSymbolsAvx2<true>(bytes, count, out) : decodeSymbolsAvx2<false>(bytes, count, out);
+	case ISA_SSE2:
+		return swap ? decodeSymbolsSse2<true>(bytes, count, out) : decodeSymbolsSse2<false>(bytes, count, out);
+#endif
+	default:
+		return swap ? decodeSymbolsScalar<true>(bytes, 0, count, out) : decodeSymbolsScalar<false>(bytes, 0, count, out);
+	}
+}
+
+// Decodes `count` consecutive .line records into `out`. `available` is the
+// number of readable bytes starting at `data`, which may be more than the
+// records themselves and lets the SSE2 kernel use wider loads.
+inline void decodeLineRecords(const void *data, size_t count, size_t available, bool swap, const LineColumns &out, Isa isa = getIsa())
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+
+	switch (isa)
+	{
+#ifdef BULK_DECODE_X86
+	case ISA_AVX2:
+		return swap ? decodeLinesAvx2<true>(bytes, count, out) : decodeLinesAvx2<false>(bytes, count, out);
+	case ISA_SSE2:
+		return swap ? decodeLinesSse2<true>(bytes, count, available, out) : decodeLinesSse2<false>(bytes, count, available, out);
+#endif
+	default:
+		return swap ? decodeLinesScalar<true>(bytes, 0, count, out) : decodeLinesScalar<false>(bytes, 0, count, out);
+	}
+}
+}
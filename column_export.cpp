@@ -0,0 +1,152 @@
+#include "column_export.h"
+
+static uint32_t typeId(const Cpp::Type &type)
+{
+	if (type.isFundamentalType || !type.userType)
+		return ColumnWriter::NONE;
+
+	return type.userType->offset;
+}
+
+static uint32_t fundType(const Cpp::Type &type)
+{
+	return type.isFundamentalType ? (uint32_t)type.fundamentalType : 0;
+}
+
+// Modifiers past the 8th don't fit and are dropped, see column_export.h
+static uint32_t packModifiers(const Cpp::Type &type)
+{
+	uint32_t packed = 0;
+
+	for (size_t i = 0; i < type.modifiers.size() && i < 8; i++)
+		packed |= (uint32_t)(type.modifiers[i] + 1) << (i * 4);
+
+	return packed;
+}
+
+ColumnExport::ColumnExport()
+{
+	using C = ColumnWriter;
+
+	m_files = m_writer.addTable("files", {
+		{ "name", C::STRING } });
+
+	m_types = m_writer.addTable("types", {
+		{ "id", C::UINT32 }, { "file", C::UINT32 }, { "tag", C::UINT32 }, { "name", C::STRING },
+		{ "size", C::INT32 }, { "align", C::INT32 } });
+
+	m_members = m_writer.addTable("members", {
+		{ "type", C::UINT32 }, { "index", C::UINT32 }, { "name", C::STRING }, { "offset", C::INT32 },
+		{ "size", C::INT32 }, { "padding", C::INT32 }, { "bitOffset", C::INT32 }, { "bitSize", C::INT32 },
+		{ "typeId", C::UINT32 }, { "fundType", C::UINT32 }, { "modifiers", C::UINT32 } });
+
+	m_functions = m_writer.addTable("functions", {
+		{ "file", C::UINT32 }, { "name", C::STRING }, { "mangled", C::STRING }, { "start", C::UINT32 },
+		{ "end", C::UINT32 }, { "owner", C::UINT32 }, { "global", C::UINT32 }, { "returnTypeId", C::UINT32 },
+		{ "returnFundType", C::UINT32 }, { "returnModifiers", C::UINT32 }, { "params", C::UINT32 } });
+
+	m_variables = m_writer.addTable("variables", {
+		{ "file", C::UINT32 }, { "function", C::UINT32 }, { "kind", C::UINT32 }, { "name", C::STRING },
+		{ "typeId", C::UINT32 }, { "fundType", C::UINT32 }, { "modifiers", C::UINT32 } });
+
+	m_lines = m_writer.addTable("lines", {
+		{ "function", C::UINT32 }, { "line", C::INT32 }, { "char", C::INT32 }, { "address", C::UINT32 } });
+
+	m_symbols = m_writer.addTable("symbols", {
+		{ "name", C::STRING }, { "address", C::UINT32 }, { "size", C::UINT32 }, { "function", C::UINT32 },
+		{ "global", C::UINT32 } });
+}
+
+void ColumnExport::addFile(Cpp::File *cpp)
+{
+	uint32_t file = (uint32_t)m_files->size();
+
+	m_files->add({ m_writer.string(cpp->filename) });
+
+	for (Cpp::UserType *ut : cpp->userTypes)
+		addUserType(ut, file);
+
+	for (Cpp::Function &f : cpp->functions)
+		addFunction(f, file);
+
+	for (Cpp::Variable &v : cpp->variables)
+		addVariable(v, file, ColumnWriter::NONE, 0);
+}
+
+void ColumnExport::addUserType(Cpp::UserType *ut, uint32_t file)
+{
+	m_types->add({ ut->offset, file, (uint32_t)ut->type, m_writer.string(ut->getName()),
+		(uint32_t)ut->layoutSize, (uint32_t)ut->layoutAlignment });
+
+	bool isClass = (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION);
+
+	if (!isClass || !ut->classData)
+		return;
+
+	uint32_t index = 0;
+
+	for (Cpp::ClassType::Member &m : ut->classData->members)
+	{
+		m_members->add({ ut->offset, index++, m_writer.string(m.name), (uint32_t)m.offset,
+			(uint32_t)m.type.size(), (uint32_t)m.padding, (uint32_t)m.bit_offset, (uint32_t)m.bit_size,
+			typeId(m.type), fundType(m.type), packModifiers(m.type) });
+	}
+}
+
+void ColumnExport::addFunction(Cpp::Function &f, uint32_t file)
+{
+	uint32_t function = (uint32_t)m_functions->size();
+
+	m_functions->add({ file, m_writer.string(f.name), m_writer.string(f.mangledName), f.startAddress,
+		f.endAddress, f.typeOwner ? f.typeOwner->offset : ColumnWriter::NONE, f.isGlobal ? 1u : 0u,
+		typeId(f.returnType), fundType(f.returnType), packModifiers(f.returnType), (uint32_t)f.parameters.size() });
+
+	for (Cpp::FunctionType::Parameter &p : f.parameters)
+		addVariable(p, file, function);
+
+	// The table has no lexical blocks, so this is the flat list the C++
+	// output declares: the locals of the function's outermost blocks
+	for (Cpp::Variable &v : f.variables)
+		addVariable(v, file, function, 1);
+
+	if (!f.dwarf)
+		return;
+
+	const Dwarf::LineTable &lines = f.dwarf->lineTable;
+	std::pair<const Dwarf::LineTable::Chunk*, const Dwarf::LineTable::Chunk*> chunks = lines.findChunks(f.startAddress);
+
+	for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk)
+	{
+		for (size_t i = chunk->begin; i < chunk->end; i++)
+		{
+			m_lines->add({ function, (uint32_t)lines.lineNumber[i], (uint32_t)(int)lines.charOffset[i],
+				f.startAddress + lines.addressOffset[i] });
+		}
+	}
+}
+
+void ColumnExport::addVariable(Cpp::Variable &v, uint32_t file, uint32_t function, uint32_t kind)
+{
+	m_variables->add({ file, function, kind, m_writer.string(v.name),
+		typeId(v.type), fundType(v.type), packModifiers(v.type) });
+}
+
+void ColumnExport::addVariable(Cpp::FunctionType::Parameter &p, uint32_t file, uint32_t function)
+{
+	m_variables->add({ file, function, 2, m_writer.string(p.name),
+		typeId(p.type), fundType(p.type), packModifiers(p.type) });
+}
+
+void ColumnExport::addSymbols(const SymbolTable &symbols)
+{
+	for (const SymbolInfo &symbol : symbols.getAllSymbols())
+	{
+		m_symbols->add({ m_writer.string(symbol.name), symbol.address, symbol.size,
+			symbol.is_function ? 1u : 0u, symbol.is_global ? 1u : 0u });
+	}
+}
+
+bool ColumnExport::write(const char *filename)
+{
+	return m_writer.write(filename);
+}
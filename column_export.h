@@ -0,0 +1,57 @@
+#pragma once
+
+#include "cpp.h"
+#include "column_writer.h"
+#include "symbol_table.h"
+
+// Turns the converted model into columnar tables, see column_writer.h for the
+// file layout. Files are added as they are converted and everything is
+// written at the end. The tables and their columns:
+//
+//   files      name
+//   types      id, file, tag, name, size, align
+//   members    type, index, name, offset, size, padding, bitOffset, bitSize,
+//              typeId, fundType, modifiers
+//   functions  file, name, mangled, start, end, owner, global, returnTypeId,
+//              returnFundType, returnModifiers, params
+//   variables  file, function, kind, name, typeId, fundType, modifiers
+//   lines      function, line, char, address
+//   symbols    name, address, size, function, global
+//
+// Types are identified by the offset of their DWARF entry, files and functions
+// by their row. A reference to a type is split into typeId (or NONE for
+// fundamental types), fundType (the FundamentalType code, or 0) and modifiers,
+// which holds one Type::Modifier + 1 per 4 bits, first modifier in the lowest
+// bits. Only the first 8 modifiers fit, and any after them are dropped. Tags
+// are the UserType enum values: 0 class, 1 union, 2 struct, 3 enum, 4 array, 5
+// function. Variable kinds are 0 for global and file variables, 1 for the
+// locals of a function's outermost lexical blocks (those the C++ output
+// declares) and 2 for parameters; `function` is NONE for kind 0. Bit offsets
+// and sizes are -1 for members that aren't bit fields, and character offsets
+// -1 where the line record has none.
+class ColumnExport
+{
+public:
+	ColumnExport();
+
+	void addFile(Cpp::File *cpp);
+	void addSymbols(const SymbolTable &symbols);
+
+	// Returns false if the file couldn't be written
+	bool write(const char *filename);
+
+private:
+	ColumnWriter m_writer;
+	ColumnWriter::Table *m_files;
+	ColumnWriter::Table *m_types;
+	ColumnWriter::Table *m_members;
+	ColumnWriter::Table *m_functions;
+	ColumnWriter::Table *m_variables;
+	ColumnWriter::Table *m_lines;
+	ColumnWriter::Table *m_symbols;
+
+	void addUserType(Cpp::UserType *ut, uint32_t file);
+	void addFunction(Cpp::Function &f, uint32_t file);
+	void addVariable(Cpp::Variable &v, uint32_t file, uint32_t function, uint32_t kind);
+	void addVariable(Cpp::FunctionType::Parameter &p, uint32_t file, uint32_t function);
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "buffered_output.h"
+#include "string_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Collects tables of fixed-width 32-bit columns and writes them into one file
+// that can be mapped and scanned in place:
+//
+//   header     magic "D2CCOLS\0", u32 version, u32 byte order mark 0x01020304,
+//              u32 table count, u32 column count, u64 string heap offset,
+//              u64 string heap size
+//   tables     per table: char name[24], u32 row count, u32 first column index
+//   columns    per column: char name[24], u32 type, u32 table index,
+//              u64 offset of the column's values
+//   values     the values of each column, row count u32s, 8-byte aligned
+//   strings    null-terminated strings; a STRING value is an offset into
+//              this heap, and offset 0 is the empty string
+//
+// Names are null-padded. Everything is in the byte order of the machine that
+// wrote the file, which the byte order mark tells.
+class ColumnWriter
+{
+public:
+	enum ColumnType : uint32_t
+	{
+		UINT32 = 1,
+		INT32 = 2,
+		STRING = 3
+	};
+
+	struct ColumnDesc
+	{
+		const char *name;
+		ColumnType type;
+	};
+
+	class Table
+	{
+	public:
+		Table(const char *name, std::initializer_list<ColumnDesc> columns)
+			: m_name(name), m_columns(columns), m_values(columns.size())
+		{
+		}
+
+		// Appends one row, with a value for every column in order. Signed
+		// values are stored as their two's complement.
+		void add(std::initializer_list<uint32_t> row)
+		{
+			size_t column = 0;
+
+			for (uint32_t value : row)
+				m_values[column++].push_back(value);
+		}
+
+		size_t size() const
+		{
+			return m_values.empty() ? 0 : m_values[0].size();
+		}
+
+	private:
+		friend class ColumnWriter;
+
+		const char *m_name;
+		std::vector<ColumnDesc> m_columns;
+		std::vector<std::vector<uint32_t>> m_values;
+	};
+
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint32_t NONE = 0xffffffff; // For missing references
+
+	ColumnWriter()
+	{
+		m_strings.push_back('\0');
+	}
+
+	// Tables are written in the order they were added. The returned pointer
+	// stays valid as long as the writer.
+	Table* addTable(const char *name, std::initializer_list<ColumnDesc> columns)
+	{
+		m_tables.emplace_back(new Table(name, columns));
+		return m_tables.back().get();
+	}
+
+	// Adds a string to the heap, once, and returns its offset
+	uint32_t string(std::string_view str)
+	{
+		if (str.empty())
+			return 0;
+
+		// Interned strings are unique, so their address identifies them
+		const char *key = m_stringPool.intern(str);
+		auto it = m_stringOffsets.find(key);
+
+		if (it != m_stringOffsets.end())
+			return it->second;
+
+		uint32_t offset = (uint32_t)m_strings.size();
+
+		m_strings.append(str.data(), str.size());
+		m_strings.push_back('\0');
+		m_stringOffsets.emplace(key, offset);
+
+		return offset;
+	}
+
+	// Writes every table. Returns false if the file couldn't be written.
+	bool write(const char *filename)
+	{
+		BufferedOutput out(filename);
+
+		if (out.hasError())
+			return false;
+
+		uint32_t numColumns = 0;
+
+		for (auto &table : m_tables)
+			numColumns += (uint32_t)table->m_columns.size();
+
+		const uint64_t headerSize = 8 + 4 * 4 + 8 * 2;
+		const uint64_t tableSize = 24 + 4 * 2;
+		const uint64_t columnSize = 24 + 4 * 2 + 8;
+
+		uint64_t offset = align(headerSize + tableSize * m_tables.size() + columnSize * numColumns);
+
+		// Column value offsets, in order
+		std::vector<uint64_t> valueOffsets;
+
+		for (auto &table : m_tables)
+		{
+			for (size_t c = 0; c < table->m_columns.size(); c++)
+			{
+				valueOffsets.push_back(offset);
+				offset = align(offset + table->size() * sizeof(uint32_t));
+			}
+		}
+
+		uint64_t heapOffset = offset;
+		uint64_t heapSize = m_strings.size();
+
+		out.write("D2CCOLS", 8);
+		put32(out, VERSION);
+		put32(out, 0x01020304);
+		put32(out, (uint32_t)m_tables.size());
+		put32(out, numColumns);
+		put64(out, heapOffset);
+		put64(out, heapSize);
+
+		uint32_t firstColumn = 0;
+
+		for (auto &table : m_tables)
+		{
+			putName(out, table->m_name);
+			put32(out, (uint32_t)table->size());
+			put32(out, firstColumn);
+			firstColumn += (uint32_t)table->m_columns.size();
+		}
+
+		size_t column = 0;
+
+		for (size_t t = 0; t < m_tables.size(); t++)
+		{
+			for (const ColumnDesc &desc : m_tables[t]->m_columns)
+			{
+				putName(out, desc.name);
+				put32(out, desc.type);
+				put32(out, (uint32_t)t);
+				put64(out, valueOffsets[column++]);
+			}
+		}
+
+		uint64_t position = headerSize + tableSize * m_tables.size() + columnSize * numColumns;
+
+		for (auto &table : m_tables)
+		{
+			for (std::vector<uint32_t> &values : table->m_values)
+			{
+				out.fill('\0', align(position) - position);
+				position = align(position);
+
+				out.write((const char*)values.data(), values.size() * sizeof(uint32_t));
+				position += values.size() * sizeof(uint32_t);
+			}
+		}
+
+		out.fill('\0', heapOffset - position);
+		out.write(m_strings.data(), m_strings.size());
+
+		return out.close();
+	}
+
+private:
+	std::vector<std::unique_ptr<Table>> m_tables;
+	std::string m_strings;
+	StringPool m_stringPool;
+	std::unordered_map<const char*, uint32_t> m_stringOffsets;
+
+	static uint64_t align(uint64_t offset)
+	{
+		return (offset + 7) & ~(uint64_t)7;
+	}
+
+	static void put32(BufferedOutput &out, uint32_t value)
+	{
+		out.write((const char*)&value, sizeof(value));
+	}
+
+	static void put64(BufferedOutput &out, uint64_t value)
+	{
+		out.write((const char*)&value, sizeof(value));
+	}
+
+	static void putName(BufferedOutput &out, const char *name)
+	{
+		char field[24] = {};
+		strncpy(field, name, sizeof(field) - 1);
+		out.write(field, sizeof(field));
+	}
+};
@@ -0,0 +1,1255 @@
+#include "converter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+static inline std::string toHexString(int x)
+{
+	std::stringstream ss;
+	ss << std::hex << std::showbase << x;
+	return ss.str();
+}
+
+Converter::Converter(const Options &options, const SymbolTable *symbolTable)
+	: m_options(options)
+{
+	m_symbolTable = symbolTable;
+	m_unitOffset = 0;
+}
+
+Converter::~Converter()
+{
+	for (Cpp::File *cpp : files)
+		delete cpp;
+
+	for (auto &pair : typesByOffset)
+		delete pair.second;
+}
+
+bool Converter::error(std::string errorMessage)
+{
+	errors.push_back(Error{ m_unitOffset, std::move(errorMessage) });
+	return false;
+}
+
+void Converter::selectReachableTypes(Cpp::File *cpp) const
+{
+	if (!m_options.reachableOnly)
+		return;
+
+	std::function<bool(Cpp::UserType*)> isRoot;
+
+	if (!m_options.filter.types.empty())
+		isRoot = [this](Cpp::UserType *ut) { return m_options.filter.matchType(ut->getName()); };
+
+	Cpp::removeUnreachableTypes(cpp, isRoot);
+}
+
+void Converter::trimCaches()
+{
+	m_typeNamePool.clear();
+	m_demangler.clear();
+}
+
+Cpp::File* Converter::findCppFile(Dwarf::Entry *entry, const char **outFilename)
+{
+	Dwarf::Attribute *nameAttr = entry->get(DW_AT_name);
+
+	*outFilename = nameAttr ? nameAttr->getString() : nullptr;
+
+	if (*outFilename)
+	{
+		for (Cpp::File *cpp : files)
+		{
+			if (cpp->filename == *outFilename)
+				return cpp;
+		}
+	}
+
+	return nullptr;
+}
+
+// Interns a type name as it will be written, so "a@b" and "a_b" count as the same name
+const char* Converter::internTypeName(std::string_view name)
+{
+	if (name.find('@') == std::string_view::npos)
+		return m_typeNamePool.intern(name);
+
+	return m_typeNamePool.intern(Cpp::SanitizeName(name));
+}
+
+// Numbers the user types of the current compile unit that share a name, and
+// names unnamed types "type". The names themselves are built when written.
+void Converter::assignNameSuffixes()
+{
+	for (UnitTypeName &t : m_unitTypeNames)
+	{
+		bool duplicate = m_typeNameCounts.get(t.name) > 1;
+		t.type->nameSuffix = duplicate ? t.index : Cpp::UserType::NO_SUFFIX;
+	}
+}
+
+// '@' is written as '_' in type names
+static std::string getClassKey(std::string_view name)
+{
+	std::string key(name);
+	std::replace(key.begin(), key.end(), '@', '_');
+	return key;
+}
+
+// Adds a converted type to m_classesByName if it is a named class
+void Converter::rememberClass(Cpp::UserType *ut)
+{
+	bool isClass = (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION);
+
+	if (isClass && ut->classData && !ut->name.empty())
+		m_classesByName[getClassKey(ut->name)].push_back(ut);
+}
+
+// The class a static member function belongs to: the one converted last with
+// that name. That is the class of the current compile unit if it has one, or
+// else the closest earlier one.
+Cpp::UserType* Converter::findClass(const std::string &className)
+{
+	auto classes = m_classesByName.find(className);
+
+	if (classes == m_classesByName.end())
+		return nullptr;
+
+	for (auto it = classes->second.rbegin(); it != classes->second.rend(); ++it)
+	{
+		if ((*it)->hasName(className))
+			return *it;
+	}
+
+	return nullptr;
+}
+
+// Adds the static member functions of the current compile unit to their
+// classes. A class gets each function once, even if several compile units
+// define it.
+void Converter::assignStaticMethods()
+{
+	for (StaticMethod &method : m_unitStaticMethods)
+	{
+		Cpp::UserType *owner = findClass(method.className);
+
+		if (!owner)
+			continue;
+
+		Cpp::Function &f = method.cpp->functions[method.index];
+		f.typeOwner = owner;
+
+		std::vector<Cpp::Function> &functions = owner->classData->functions;
+
+		bool known = std::any_of(functions.begin(), functions.end(), [&](const Cpp::Function &other) {
+			return other.mangledName == f.mangledName;
+		});
+
+		if (!known)
+			functions.push_back(f);
+	}
+}
+
+// Removes a type from m_classesByName once no more functions may be added to it
+void Converter::forgetClass(Cpp::UserType *ut)
+{
+	if (ut->name.empty())
+		return;
+
+	auto classes = m_classesByName.find(getClassKey(ut->name));
+
+	if (classes == m_classesByName.end())
+		return;
+
+	auto it = std::find(classes->second.begin(), classes->second.end(), ut);
+
+	if (it != classes->second.end())
+		classes->second.erase(it);
+
+	if (classes->second.empty())
+		m_classesByName.erase(classes);
+}
+
+bool Converter::convert(Dwarf *dwarf)
+{
+	Dwarf::Entry *entry = &dwarf->entries.front();
+
+	while (entry)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_compile_unit:
+		case DW_TAG_MW_overlay_branch: // Metrowerks overlay branch - handle like compile unit
+		{
+			const char *filename;
+			Cpp::File *cpp = findCppFile(entry, &filename);
+
+			// The children of skipped compile units were never decoded
+			if (!m_options.filter.matchCompileUnit(filename ? filename : ""))
+				break;
+
+			bool found = (cpp != nullptr);
+
+			if (!found)
+			{
+				cpp = new Cpp::File;
+				cpp->filename = filename;
+			}
+
+			m_unitOffset = entry->offset;
+
+			if (!processCompileUnit(entry, cpp))
+				return error(std::string("Failed to processCompileUnit for '").append(cpp->filename).append("'"));
+
+			bool empty = cpp->userTypes.empty() && cpp->functions.empty() && cpp->variables.empty();
+
+			// Unselected types only stay if something selected uses them
+			if (m_options.reachableOnly && cpp->functions.empty() && cpp->variables.empty())
+				empty = std::none_of(cpp->userTypes.begin(), cpp->userTypes.end(), [this](Cpp::UserType *ut) { return m_options.filter.matchType(ut->getName()); });
+
+			if (!found && !(empty && m_options.filter.selectsMembers()))
+				files.push_back(cpp);
+			else if (!found)
+				delete cpp;
+
+			//std::cout << "Found compile unit " << cpp->filename << std::endl;
+			//std::cout << "\t" << std::to_string(cpp->userTypes.size()) << " user types" << std::endl;
+			//std::cout << "\t" << std::to_string(cpp->variables.size()) << " variables" << std::endl;
+
+			break;
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	if (!convertSkippedTypes())
+		return false;
+
+	// Referenced entries that were never converted, such as types nested in
+	// functions, leave placeholders without any data. Those of later unit
+	// views may still be converted.
+	Elf32_Off begin = dwarf->units.front().begin;
+	Elf32_Off end = dwarf->units.back().end;
+
+	size_t numMissing = std::count_if(m_placeholders.begin(), m_placeholders.end(), [end](Cpp::UserType *ut) { return ut->offset < end; });
+
+	if (numMissing != 0)
+		return error(std::to_string(numMissing) + " type reference(s) don't point at a converted type.");
+
+	// Sizes are read from several threads later on, so compute them all now.
+	// Types of earlier streamed units are done already.
+	if (m_placeholders.empty())
+		computeLayouts(begin, end);
+
+	return true;
+}
+
+void Converter::computeLayouts(Elf32_Off begin, Elf32_Off end)
+{
+	std::vector<Cpp::UserType*> userTypes;
+	auto first = typesByOffset.lower_bound(begin);
+	auto last = typesByOffset.lower_bound(end);
+
+	for (auto it = first; it != last; ++it)
+		userTypes.push_back(it->second);
+
+	Cpp::computeLayouts(userTypes);
+}
+
+void Converter::releaseTypes(Elf32_Off begin, Elf32_Off end)
+{
+	auto first = typesByOffset.lower_bound(begin);
+	auto last = typesByOffset.lower_bound(end);
+
+	for (auto it = first; it != last; ++it)
+		delete it->second;
+
+	typesByOffset.erase(first, last);
+	m_skippedUnits.erase(m_skippedUnits.lower_bound(begin), m_skippedUnits.lower_bound(end));
+}
+
+bool Converter::matchFunctionEntry(Dwarf::Entry *entry) const
+{
+	if (!m_options.filter.selectsMembers())
+		return true;
+
+	Dwarf::Attribute *name = entry->get(DW_AT_name);
+	Dwarf::Attribute *mangledName = entry->get(DW_AT_mangled_name);
+
+	return m_options.filter.matchFunction(name ? name->getString() : "", mangledName ? mangledName->getString() : "");
+}
+
+bool Converter::processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
+{
+	m_typeNameCounts.reset();
+	m_unitTypeNames.clear();
+	m_unitStaticMethods.clear();
+
+	Dwarf::Entry *next = entry->getSibling();
+
+	// Without a sibling, the children run to the end of the decoded entries
+	if (!next)
+		next = entry->dwarf->entries.data() + entry->dwarf->entries.size();
+	Dwarf::Attribute *nameAttr = entry->get(DW_AT_name);
+
+	if (nameAttr)
+		cpp->filename = nameAttr->getString();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			if (!m_options.filter.matchVariables())
+				break;
+
+			Cpp::Variable var;
+
+			if (!processVariable(entry, &var))
+				return error("Failed to processVar.");
+
+			cpp->variables.push_back(var);
+			break;
+		}
+		case DW_TAG_class_type:
+		case DW_TAG_structure_type:
+		case DW_TAG_enumeration_type:
+		case DW_TAG_array_type:
+		case DW_TAG_subroutine_type:
+		case DW_TAG_union_type:
+		{
+			// Types that aren't selected are still converted, since selected
+			// types and functions may refer to them. With --reachable they are
+			// listed as well, and selectReachableTypes() keeps the used ones.
+			Cpp::UserType *userType = getUserType(entry);
+			processUserType(entry, userType);
+			rememberClass(userType);
+
+			if (!m_options.filter.selectsMembers() || m_options.reachableOnly || m_options.filter.matchType(userType->getName()))
+			{
+				userType->index = cpp->userTypes.size();
+				cpp->userTypes.push_back(userType);
+			}
+
+			UnitTypeName typeName;
+			typeName.type = userType;
+			typeName.name = internTypeName(userType->name);
+			typeName.index = m_typeNameCounts.increment(typeName.name);
+			m_unitTypeNames.push_back(typeName);
+			break;
+		}
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine:
+		{
+			if (!matchFunctionEntry(entry))
+				break;
+
+			Cpp::Function f;
+			f.dwarf = entry->dwarf;
+
+			if (!processFunctionType(entry, &f))
+				return error("Failed to processFunctionType.");
+
+			if (!processFunction(entry, &f))
+				return error("Failed to processFunction.");
+
+			cpp->functions.push_back(f);
+
+			std::string className;
+
+			if (!f.typeOwner && getMangledClassName(f.mangledName, &className))
+				m_unitStaticMethods.push_back(StaticMethod{ cpp, cpp->functions.size() - 1, std::move(className) });
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	assignNameSuffixes();
+	assignStaticMethods();
+
+	return true;
+}
+
+bool Converter::processVariable(Dwarf::Entry *entry, Cpp::Variable *var)
+{
+	var->isGlobal = (entry->tag == DW_TAG_global_variable);
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			var->name = attr->getString();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &var->type))
+				return error(std::string("Failed to processTypeAttr for variable '").append(var->name).append("'."));
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool Converter::processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	switch (attr->name)
+	{
+	case DW_AT_fund_type:
+	{
+		type->isFundamentalType = true;
+		type->fundamentalType = (Cpp::FundamentalType)attr->getHword();
+		break;
+	}
+	case DW_AT_user_def_type:
+	{
+		type->isFundamentalType = false;
+
+		if (!findUserType(dwarf, attr->getReference(), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_user_def_type."));
+
+		break;
+	}
+	case DW_AT_mod_fund_type:
+	{
+		type->isFundamentalType = true;
+
+		const char *mod = attr->getBlock();
+		const char *end = mod + attr->size - sizeof(Elf32_Half);
+
+		type->fundamentalType = (Cpp::FundamentalType)dwarf->read<Elf32_Half>(end);
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	case DW_AT_mod_u_d_type:
+	{
+		type->isFundamentalType = false;
+
+		const char *mod = attr->getBlock();
+		const char *end = mod + attr->size - sizeof(Elf32_Off);
+
+		if (!findUserType(dwarf, dwarf->read<Elf32_Off>(end), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_mod_u_d_type."));
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	}
+
+	return true;
+}
+
+bool Converter::processLocationAttr(Dwarf::Attribute *attr, int *location)
+{
+	// I don't really know how location is supposed to be handled,
+	// so I just look for a DW_OP_CONST and use that as the "location"
+
+	Dwarf *dwarf = attr->dwarf;
+
+	const char *block = attr->getBlock();
+	const char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char op = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (op == DW_OP_CONST)
+		{
+			*location = dwarf->read<Elf32_Word>(block);
+			break;
+		}
+	}
+
+	return true;
+}
+
+static bool isUserTypeTag(Elf32_Half tag)
+{
+	switch (tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_enumeration_type:
+	case DW_TAG_array_type:
+	case DW_TAG_subroutine_type:
+	case DW_TAG_union_type:
+		return true;
+	}
+
+	return false;
+}
+
+// Decodes a compile unit the filter skipped and numbers its user types
+Dwarf* Converter::decodeSkippedUnit(const Dwarf *section, size_t unit)
+{
+	SkippedUnit &skipped = m_skippedUnits[section->units[unit].begin];
+
+	if (skipped.view)
+		return skipped.view.get();
+
+	Dwarf *view = new Dwarf(*section, unit);
+	skipped.view.reset(view);
+
+	if (view->getError())
+	{
+		error("Failed to decode skipped compile unit at offset " + std::to_string(section->units[unit].begin) + ". Error Code: " + std::to_string(view->getError()));
+		m_skippedUnits.erase(section->units[unit].begin);
+		return nullptr;
+	}
+
+	std::vector<std::pair<Elf32_Off, std::string>> typeNames;
+	std::unordered_map<std::string, int> typeNameCounts;
+
+	Dwarf::Entry *end = view->entries.data() + view->entries.size();
+
+	for (Dwarf::Entry *entry = &view->entries.front() + 1; entry && entry < end; entry = entry->getSibling())
+	{
+		if (!isUserTypeTag(entry->tag))
+			continue;
+
+		Dwarf::Attribute *nameAttr = entry->get(DW_AT_name);
+		std::string name = Cpp::SanitizeName(nameAttr ? nameAttr->getString() : "");
+
+		skipped.nameSuffixes[entry->offset] = typeNameCounts[name]++;
+		typeNames.emplace_back(entry->offset, std::move(name));
+	}
+
+	for (auto &typeName : typeNames)
+	{
+		if (typeNameCounts[typeName.second] == 1)
+			skipped.nameSuffixes[typeName.first] = Cpp::UserType::NO_SUFFIX;
+	}
+
+	return view;
+}
+
+// Converts the types of skipped compile units that were referenced, and the
+// types those refer to in turn
+bool Converter::convertSkippedTypes()
+{
+	while (!m_skippedTypes.empty())
+	{
+		Dwarf::Entry *entry = m_skippedTypes.back();
+		m_skippedTypes.pop_back();
+
+		SkippedUnit &skipped = m_skippedUnits[entry->dwarf->units.front().begin];
+		auto nameSuffix = skipped.nameSuffixes.find(entry->offset);
+
+		// Types nested in functions aren't converted, as in any other unit
+		if (nameSuffix == skipped.nameSuffixes.end())
+			continue;
+
+		Cpp::UserType *userType = getUserType(entry);
+
+		if (!processUserType(entry, userType))
+			return error(std::string("Failed to processUserType for user type '").append(userType->name).append("' of a skipped compile unit."));
+
+		userType->nameSuffix = nameSuffix->second;
+	}
+
+	return true;
+}
+
+// Compile units are converted in one walk, so a type may be referenced before
+// its entry is reached. The first reference creates an empty placeholder,
+// which getUserType() hands out again when the entry is converted. A unit view
+// may refer to types of other units, which can't be checked here; they were
+// converted already or get a placeholder as well. Types of compile units the
+// filter skipped are converted once the referencing unit is done.
+bool Converter::findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u)
+{
+	Dwarf::Entry *entry = dwarf->getEntryFromReference(ref);
+	bool decoded = (ref >= dwarf->units.front().begin && ref < dwarf->units.back().end);
+
+	const Dwarf *section = dwarf->parent ? dwarf->parent : dwarf;
+	size_t unit = section->findUnit(ref);
+	bool skipped = (unit < section->units.size() && section->units[unit].skipped);
+
+	if (!entry && skipped)
+	{
+		Dwarf *view = decodeSkippedUnit(section, unit);
+
+		if (!view)
+			return false;
+
+		entry = view->getEntryFromReference(ref);
+		decoded = true;
+	}
+
+	if (entry ? !isUserTypeTag(entry->tag) : (decoded || unit == section->units.size()))
+		return error(std::string("Failed to findUserType for reference '").append(std::to_string(ref)).append("'."));
+
+	Cpp::UserType *&userType = typesByOffset[ref];
+
+	if (!userType)
+	{
+		userType = new Cpp::UserType;
+		userType->offset = ref;
+		m_placeholders.insert(userType);
+
+		if (skipped)
+			m_skippedTypes.push_back(entry);
+	}
+
+	*u = userType;
+
+	return true;
+}
+
+// The user type of an entry about to be converted
+Cpp::UserType* Converter::getUserType(Dwarf::Entry *entry)
+{
+	Cpp::UserType *&userType = typesByOffset[entry->offset];
+
+	if (userType)
+	{
+		m_placeholders.erase(userType);
+		return userType;
+	}
+
+	userType = new Cpp::UserType;
+	userType->offset = entry->offset;
+	return userType;
+}
+
+bool Converter::processUserType(Dwarf::Entry *entry, Cpp::UserType *userType)
+{
+	Dwarf::Attribute *nameAttr = entry->get(DW_AT_name);
+
+	// '@' is replaced when the name is written, see Cpp::SanitizeName
+	if (nameAttr)
+		userType->name = nameAttr->getString();
+
+	bool isClass = (entry->tag == DW_TAG_class_type || entry->tag == DW_TAG_structure_type || entry->tag == DW_TAG_union_type);
+
+	if (!isClass && m_pendingMethods.count(userType) != 0)
+		return error(std::string("The 'this' parameter of member function '").append(m_pendingMethods[userType].front().name).append("' doesn't point at a class."));
+
+	switch (entry->tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_union_type:
+	{
+		userType->type = (entry->tag == DW_TAG_structure_type) ? Cpp::UserType::STRUCT : ((entry->tag == DW_TAG_union_type) ? Cpp::UserType::UNION : Cpp::UserType::CLASS);
+		userType->classData = new Cpp::ClassType;
+		userType->classData->parent = userType;
+
+		if (!processClassType(entry, userType->classData))
+			return error(std::string("Failed to processClassType for user type '").append(userType->name).append("'."));
+
+		// Member functions converted before the class
+		auto pending = m_pendingMethods.find(userType);
+
+		if (pending != m_pendingMethods.end())
+		{
+			for (Cpp::Function &f : pending->second)
+				userType->classData->functions.push_back(std::move(f));
+
+			m_pendingMethods.erase(pending);
+		}
+
+		break;
+	}
+	case DW_TAG_enumeration_type:
+		userType->type = Cpp::UserType::ENUM;
+		userType->enumData = new Cpp::EnumType;
+
+		if (!processEnumType(entry, userType->enumData))
+			return error(std::string("Failed to processEnumType for user type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_array_type:
+		userType->type = Cpp::UserType::ARRAY;
+		userType->arrayData = new Cpp::ArrayType;
+
+		if (!processArrayType(entry, userType->arrayData))
+			return error(std::string("Failed to processArrayType for array type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_subroutine_type:
+		userType->type = Cpp::UserType::FUNCTION;
+		userType->functionData = new Cpp::FunctionType;
+
+		if (!processFunctionType(entry, userType->functionData))
+			return error(std::string("Failed to processFunctionType for function type '").append(userType->name).append("'."));
+
+		break;
+	}
+
+	return true;
+}
+
+bool Converter::processClassType(Dwarf::Entry *entry, Cpp::ClassType *c)
+{
+	Dwarf::Attribute *sizeAttr = entry->get(DW_AT_byte_size);
+	c->size = sizeAttr ? sizeAttr->getWord() : 0;
+
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int memberCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_member)
+			memberCount++;
+
+		entry = entry->getSibling();
+	}
+
+	c->members.reserve(memberCount);
+	entry = first + 1;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_member:
+		{
+			Cpp::ClassType::Member m;
+
+			if (!processMember(entry, &m))
+				return error("Failed to processMember for class type.");
+
+			c->members.push_back(m);
+			break;
+		}
+		case DW_TAG_inheritance:
+			Cpp::ClassType::Inheritance i;
+
+			if (!processInheritance(entry, &i))
+				return error("Failed to processInheritance for class type.");
+
+			c->inheritances.push_back(i);
+			break;
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool Converter::processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m)
+{
+	m->bit_offset = -1;
+	m->bit_size = -1;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			m->name = attr->getString();
+			break;
+		case DW_AT_bit_offset:
+			m->bit_offset = attr->getHword();
+			break;
+		case DW_AT_bit_size:
+			m->bit_size = attr->getWord();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &m->type))
+				return error(std::string("Failed to processTypeAttr for member '").append(m->name).append("'."));
+			break;
+		case DW_AT_location:
+			if (!processLocationAttr(attr, &m->offset))
+				return error(std::string("Failed to processLocationAttr for member '").append(m->name).append("'."));
+		}
+	}
+
+	return true;
+}
+
+bool Converter::processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_)
+{
+	Dwarf::Attribute *typeAttr = entry->get(DW_AT_user_def_type);
+
+	if (typeAttr && !processTypeAttr(typeAttr, &i_->type))
+		return error("Failed to processTypeAttr for inheritance.");
+
+	Dwarf::Attribute *locationAttr = entry->get(DW_AT_location);
+
+	if (locationAttr && !processLocationAttr(locationAttr, &i_->offset))
+		return error("Failed to processLocationAttr for inheritance.");
+
+	return true;
+}
+
+bool Converter::processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e)
+{
+	int byte_size = 0;
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_byte_size:
+			byte_size = attr->getWord();
+
+			switch (byte_size) {
+			case 1:
+				e->baseType = Cpp::FundamentalType::UNSIGNED_CHAR;
+				break;
+			case 2:
+				e->baseType = Cpp::FundamentalType::UNSIGNED_SHORT;
+				break;
+			case 4:
+				e->baseType = Cpp::FundamentalType::INT;
+				break;
+			case 8:
+				e->baseType = Cpp::FundamentalType::LONG;
+				break;
+			default:
+				return error(std::string("Unknown enum base type size for enum type. (Size: ").append(std::to_string(byte_size)).append(")"));
+				break;
+			}
+			break;
+		case DW_AT_element_list:
+			if (!processElementList(attr, e, byte_size))
+				return error("Failed to processElementList for enum type.");
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool Converter::processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	const char *block = attr->getBlock();
+	const char *end = block + attr->size;
+
+	while (block < end)
+	{
+		Cpp::EnumType::Element element;
+
+		if (byte_size == 1) {
+			element.constValue = dwarf->read<unsigned char>(block);
+		}
+		else if (byte_size == 2) {
+			element.constValue = dwarf->read<unsigned short>(block);
+		}
+		else if (byte_size == 4) {
+			element.constValue = dwarf->read<int>(block);
+		}
+		else if (byte_size == 8) {
+			element.constValue = dwarf->read<long>(block);
+		}
+		
+		block += byte_size;
+
+		element.name = block;
+		block += element.name.size() + 1;
+
+		e->elements.push_back(element);
+	}
+
+	return true;
+}
+
+bool Converter::processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f)
+{
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int paramCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_formal_parameter)
+			paramCount++;
+
+		entry = entry->getSibling();
+	}
+
+	f->parameters.reserve(paramCount);
+	entry = first;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &f->returnType))
+				return error("Failed to processTypeAttr for function return type.");
+			break;
+		}
+	}
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_formal_parameter:
+			Cpp::FunctionType::Parameter p;
+
+			if (!processParameter(entry, &p))
+				return error("Failed to processParameter for function parameter.");
+
+			f->parameters.push_back(p);
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool Converter::processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p)
+{
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			p->name = attr->getString();
+			break;
+		case DW_AT_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_mod_u_d_type:
+			if (!processTypeAttr(attr, &p->type))
+				return error(std::string("Failed to processTypeAttr for parameter '").append(p->name).append("'."));
+			break;
+		}
+	}
+
+	return true;
+}
+
+// Reads the innermost class name from a mangled member function name.
+// Returns false if there is none.
+bool Converter::getMangledClassName(std::string_view mangledName, std::string *className)
+{
+	const Demangler::Result *demangled = m_demangler.demangle(mangledName);
+
+	if (!demangled || demangled->kind != Demangler::Result::FUNCTION || demangled->scopes.empty())
+		return false;
+
+	className->assign(demangled->getOwner());
+	return true;
+}
+
+bool Converter::processFunction(Dwarf::Entry *entry, Cpp::Function *f)
+{
+	f->isGlobal = (entry->tag == DW_TAG_global_subroutine);
+	f->startAddress = 0;
+	f->endAddress = 0;
+
+	size_t numAttributes = entry->attributes.size();
+
+	for (size_t i = 0; i < numAttributes; i++)
+	{
+		Dwarf::Attribute *attr = &entry->attributes[i];
+
+		switch (attr->name)
+		{
+		case DW_AT_name:
+			f->name = attr->getString();
+			break;
+		case DW_AT_mangled_name:
+			f->mangledName = attr->getString();
+			break;
+		case DW_AT_low_pc:
+			f->startAddress = attr->getAddress();
+			break;
+		case DW_AT_high_pc:
+			f->endAddress = attr->getAddress();
+			break;
+		}
+	}
+
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_lexical_block:
+			f->blocks.emplace_back();
+
+			if (!processLexicalBlock(entry, f, &f->blocks.back(), true))
+				return error(std::string("Failed to processLexicalBlock for function '").append(f->name).append("'."));
+		}
+
+		entry = entry->getSibling();
+	}
+
+	f->typeOwner = nullptr;
+	if (f->parameters.size() > 0 && f->parameters[0].name.compare("this") == 0) {
+		f->typeOwner = f->parameters[0].type.userType;
+		f->parameters.erase(f->parameters.begin());
+
+		if (!f->typeOwner || (!f->typeOwner->classData && m_placeholders.count(f->typeOwner) == 0))
+			return error(std::string("The 'this' parameter of function '").append(f->name).append("' doesn't point at a class."));
+
+		// The class may be in a compile unit that hasn't been converted yet
+		if (f->typeOwner->classData)
+			f->typeOwner->classData->functions.push_back(*f);
+		else
+			m_pendingMethods[f->typeOwner].push_back(*f);
+	}
+
+	// Static member functions are added to their class at the end of the
+	// compile unit, see assignStaticMethods()
+
+	// Enhance function information with symbol table data
+	if (m_symbolTable && m_symbolTable->isLoaded()) {
+		// If function name is missing, try to get it from symbol table
+		if (f->name.empty() && f->startAddress != 0) {
+			const SymbolInfo* symbol = m_symbolTable->findByAddress(f->startAddress);
+			if (symbol && symbol->is_function) {
+				f->name = symbol->name;
+			}
+		}
+		
+		// If function address is missing, try to get it from symbol table
+		if (f->startAddress == 0 && !f->name.empty()) {
+			const SymbolInfo* symbol = m_symbolTable->findByName(f->name);
+			if (symbol && symbol->is_function) {
+				f->startAddress = symbol->address;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Reads a lexical block and the blocks nested in it into `block`. When
+// `flatten` is set, the block's own variables are also added to the function's
+// variable list, which is what gets written to the output.
+bool Converter::processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f, Cpp::LexicalBlock *block, bool flatten)
+{
+	Dwarf::Attribute *lowAttr = entry->get(DW_AT_low_pc);
+	Dwarf::Attribute *highAttr = entry->get(DW_AT_high_pc);
+
+	block->startAddress = lowAttr ? lowAttr->getAddress() : 0;
+	block->endAddress = highAttr ? highAttr->getAddress() : 0;
+
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			Cpp::Variable v;
+			
+			if (!processVariable(entry, &v))
+				return error(std::string("Failed to processVariable for local var lexical block in function '").append(f->name).append("'."));
+
+			block->variables.push_back(v);
+
+			if (flatten)
+				f->variables.push_back(v);
+
+			break;
+		}
+		case DW_TAG_lexical_block:
+			block->blocks.emplace_back();
+
+			if (!processLexicalBlock(entry, f, &block->blocks.back(), false))
+				return false;
+
+			break;
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool Converter::processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a)
+{
+	Dwarf::Attribute *orderingAttr = entry->get(DW_AT_ordering);
+
+	if (orderingAttr && orderingAttr->getHword() != DW_ORD_row_major) // meh
+		return error(std::string("processArrayType encountered ordering unsupported by dwarf2cpp! (").append(toHexString(orderingAttr->getHword())).append(")"));
+
+	Dwarf::Attribute *subscrAttr = entry->get(DW_AT_subscr_data);
+
+	if (subscrAttr && !processSubscriptData(subscrAttr, a))
+		return error("Failed to processSubscriptData.");
+
+	return true;
+}
+
+bool Converter::getTypeReference(Dwarf::Attribute *attr, Elf32_Off *ref)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	switch (attr->name)
+	{
+	case DW_AT_user_def_type:
+		*ref = attr->getReference();
+		return true;
+	case DW_AT_mod_u_d_type:
+		*ref = dwarf->read<Elf32_Off>(attr->getBlock() + attr->size - sizeof(Elf32_Off));
+		return true;
+	case DW_AT_subscr_data:
+	{
+		// Like processSubscriptData(), up to the element type
+		const char *block = attr->getBlock();
+		const char *end = block + attr->size;
+
+		while (block < end)
+		{
+			char format = dwarf->read<char>(block);
+			block += sizeof(char);
+
+			if (format == DW_FMT_FT_C_C)
+			{
+				block += sizeof(Elf32_Half) + 2 * sizeof(Elf32_Word);
+				continue;
+			}
+
+			if (format != DW_FMT_ET)
+				return false;
+
+			Dwarf::Attribute typeAttr;
+			Dwarf::Error decodeError = Dwarf::ERR_NONE;
+
+			dwarf->decodeAttribute(dwarf->pointerToOffset(block), &typeAttr, &decodeError);
+			typeAttr.entryIndex = attr->entryIndex;
+
+			return !decodeError && typeAttr.name != DW_AT_subscr_data && getTypeReference(&typeAttr, ref);
+		}
+
+		return false;
+	}
+	}
+
+	return false;
+}
+
+bool Converter::processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a)
+{
+	Dwarf *dwarf = attr->dwarf;
+
+	const char *block = attr->getBlock();
+	const char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char format = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (format == DW_FMT_ET)
+		{
+			// The element type is an attribute embedded in the block
+			Dwarf::Attribute typeAttr;
+			Dwarf::Error decodeError = Dwarf::ERR_NONE;
+
+			dwarf->decodeAttribute(dwarf->pointerToOffset(block), &typeAttr, &decodeError);
+
+			if (decodeError)
+				return error("Failed to decode the element type attribute of subscript data DW_FMT_ET.");
+
+			typeAttr.entryIndex = attr->entryIndex;
+
+			if (!processTypeAttr(&typeAttr, &a->type))
+				return error("Failed to processTypeAttr for subscript data DW_FMT_ET.");
+
+			break;
+		}
+		else if (format == DW_FMT_FT_C_C)
+		{
+			Elf32_Half fundType = dwarf->read<Elf32_Half>(block);
+			block += sizeof(Elf32_Half);
+
+			// Only long indices are supported
+			if (fundType != DW_FT_long)
+				return error(std::string("Subscript data DW_FMT_FT_C_C had unsupported fundamental indice type ").append(toHexString(fundType)).append(" in type '").append(a->toNameString("")).append("'."));
+
+			Elf32_Word lowBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			// Only indices starting at 0 are supported
+			if (lowBound != 0)
+				return error(std::string("Subscript data contained indices which did not start at zero! (Start at: '").append(toHexString(lowBound)).append("', Type: '").append(a->toNameString("")).append("')"));
+
+			Elf32_Word highBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			Cpp::ArrayType::Dimension dimension;
+			dimension.size = highBound + 1;
+
+			a->dimensions.push_back(dimension);
+		}
+		else
+		{
+			// Only fundamental typed (long) indices and
+			// constant value bounds are supported
+			return error(std::string("Encountered subscript data format unsupported by dwarf2cpp! (").append(toHexString(format)).append(")"));
+		}
+	}
+
+	return true;
+}
+
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "cpp.h"
+#include "dwarf.h"
+#include "demangle.h"
+#include "filter.h"
+#include "string_pool.h"
+#include "symbol_table.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Converts decoded DWARF entries into the C++ model. A converter holds all
+// state of one conversion and owns the files and user types it creates, so
+// separate converters can run on separate threads.
+//
+// convert() may be called for several Dwarf objects in section order, such
+// as the unit views of streaming mode; files with the same name are merged,
+// functions are added to classes converted earlier, and types of other views
+// are found by their offset.
+class Converter
+{
+public:
+	struct Options
+	{
+		Filter filter;              // Compile units, types and functions to convert
+		bool reachableOnly = false; // Only keep the user types something uses, see selectReachableTypes()
+	};
+
+	// Something that couldn't be converted. Conversion continues past some
+	// of these, so a successful convert() may still have recorded errors.
+	struct Error
+	{
+		Elf32_Off offset; // Of the compile unit being converted
+		std::string message;
+	};
+
+	std::vector<Cpp::File*> files;
+	std::map<Elf32_Off, Cpp::UserType*> typesByOffset; // By the offset of their entry
+	std::vector<Error> errors;
+
+	// `symbolTable` fills in names and addresses DWARF doesn't have. It must
+	// outlive the converter; null if there is none.
+	Converter(const Options &options, const SymbolTable *symbolTable);
+	~Converter();
+
+	Converter(const Converter&) = delete;
+	Converter& operator=(const Converter&) = delete;
+
+	// Converts every compile unit of `dwarf`. Returns false if one of them
+	// couldn't be converted.
+	bool convert(Dwarf *dwarf);
+
+	// With Options::reachableOnly, drops the user types of a complete file
+	// that nothing in it uses. Types selected by the filter are kept, along
+	// with what they use.
+	void selectReachableTypes(Cpp::File *cpp) const;
+
+	// Frees the memory used for matching names, which is only needed while a
+	// compile unit is converted
+	void trimCaches();
+
+	// Stops functions converted later from being added to a class
+	void forgetClass(Cpp::UserType *ut);
+
+	// Computes the layouts of the user types between two offsets. convert()
+	// leaves this to the caller while types refer to units not converted yet.
+	void computeLayouts(Elf32_Off begin, Elf32_Off end);
+
+	// Deletes the user types between two offsets, along with the skipped
+	// compile units decoded for them
+	void releaseTypes(Elf32_Off begin, Elf32_Off end);
+
+	// Checks a function entry against the filter before anything is converted
+	bool matchFunctionEntry(Dwarf::Entry *entry) const;
+
+	// The entry a type attribute refers to, if it names a user type
+	static bool getTypeReference(Dwarf::Attribute *attr, Elf32_Off *ref);
+
+	// The class a static member function belongs to, going by its mangled name
+	bool getMangledClassName(std::string_view mangledName, std::string *className);
+
+	const Options& getOptions() const
+	{
+		return m_options;
+	}
+
+private:
+	// Names of the current compile unit's user types, for numbering duplicates
+	struct UnitTypeName
+	{
+		Cpp::UserType *type;
+		const char *name; // Interned in m_typeNamePool
+		int index;        // Number of earlier types in the unit with the same name
+	};
+
+	Options m_options;
+	const SymbolTable *m_symbolTable;
+	Elf32_Off m_unitOffset;
+
+	// User types referenced before their entry was converted, see findUserType()
+	std::unordered_set<Cpp::UserType*> m_placeholders;
+
+	// Member functions whose class was still a placeholder, see processFunction()
+	std::unordered_map<Cpp::UserType*, std::vector<Cpp::Function>> m_pendingMethods;
+
+	// Named classes, structs and unions in section order, keyed by their name as
+	// UserType::hasName reads it. Static member functions are matched to them.
+	std::unordered_map<std::string, std::vector<Cpp::UserType*>> m_classesByName;
+
+	// A compile unit the filter skipped, decoded because a converted one
+	// refers to its types. Only those types are converted, and no file.
+	struct SkippedUnit
+	{
+		std::unique_ptr<Dwarf> view;
+		std::unordered_map<Elf32_Off, int> nameSuffixes; // Of its top-level user types, as assignNameSuffixes() numbers them
+	};
+
+	std::map<Elf32_Off, SkippedUnit> m_skippedUnits; // By the offset of the unit
+	std::vector<Dwarf::Entry*> m_skippedTypes;       // Referenced types of skipped units still to convert
+
+	// A static member function of the current compile unit, which is added to
+	// its class once the unit's classes are named, see assignStaticMethods()
+	struct StaticMethod
+	{
+		Cpp::File *cpp;
+		size_t index; // In cpp->functions
+		std::string className;
+	};
+
+	std::vector<StaticMethod> m_unitStaticMethods;
+
+	StringPool m_typeNamePool;
+	InternedCounter m_typeNameCounts;
+	std::vector<UnitTypeName> m_unitTypeNames;
+
+	// Demangles function names to find the classes of static member functions
+	Demangler m_demangler;
+
+	bool error(std::string errorMessage);
+
+	Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename);
+	const char* internTypeName(std::string_view name);
+	void assignNameSuffixes();
+	void rememberClass(Cpp::UserType *ut);
+	Cpp::UserType* findClass(const std::string &className);
+	void assignStaticMethods();
+	Dwarf* decodeSkippedUnit(const Dwarf *section, size_t unit);
+	bool convertSkippedTypes();
+
+	bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
+	bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var);
+	bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
+	bool processLocationAttr(Dwarf::Attribute *attr, int *location);
+	bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
+	Cpp::UserType* getUserType(Dwarf::Entry *entry);
+	bool processUserType(Dwarf::Entry *entry, Cpp::UserType *u);
+	bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c);
+	bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m);
+	bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_);
+	bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e);
+	bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size);
+	bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f);
+	bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p);
+	bool processFunction(Dwarf::Entry *entry, Cpp::Function *f);
+	bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f, Cpp::LexicalBlock *block, bool flatten);
+	bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a);
+	bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a);
+};
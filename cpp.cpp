@@ -1,4 +1,7 @@
 #include "cpp.h"
+#include "demangle.h"
+
+#include <algorithm>
 
 namespace Cpp
 {
@@ -83,9 +86,12 @@ std::string File::toString(bool justUserTypes, bool includeComments)
 
 		ss << "\n";
 
-		// Write function definitions
+		// Write function definitions. The demangled names are only kept
+		// while this file is written.
+		Demangler demangler;
+
 		for (Function &fun : functions)
-			ss << fun.toDefinitionString() << "\n\n";
+			ss << fun.toDefinitionString(demangler) << "\n\n";
 	}
 
 	return ss.str();
@@ -118,7 +124,7 @@ std::string Type::toString(std::string varName) {
 		}
 	}
 	else {
-		result << userType->name;
+		result << userType->getName();
 	}
 
 	for (Modifier mod : modifiers)
@@ -139,10 +145,65 @@ std::string Type::toString()
 std::string Variable::toString()
 {
 	std::stringstream ss;
-	ss << type.toString(name);
+	ss << type.toString(std::string(name));
 	return ss.str();
 }
 
+UserType::~UserType()
+{
+	if (classData == nullptr)
+		return;
+
+	if (type == ENUM)
+		delete enumData;
+	else if (type == ARRAY)
+		delete arrayData;
+	else if (type == FUNCTION)
+		delete functionData;
+	else
+		delete classData;
+}
+
+std::string UserType::getName()
+{
+	if (nameSuffix == NAME_PENDING)
+		return SanitizeName(name);
+
+	std::string result = name.empty() ? "type" : SanitizeName(name);
+
+	if (nameSuffix != NO_SUFFIX)
+		result += "_" + std::to_string(nameSuffix);
+
+	return result;
+}
+
+// Same as getName() == other, without building the name
+bool UserType::hasName(const std::string &other)
+{
+	std::string_view base = (name.empty() && nameSuffix != NAME_PENDING) ? std::string_view("type") : name;
+	size_t length = base.size();
+
+	if (other.size() < length)
+		return false;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (other[i] != (base[i] == '@' ? '_' : base[i]))
+			return false;
+	}
+
+	if (nameSuffix == NAME_PENDING)
+		return other.size() == length;
+
+	if (nameSuffix == NO_SUFFIX)
+		return other.size() == length;
+
+	char suffix[16];
+	int suffixLength = snprintf(suffix, sizeof(suffix), "_%d", nameSuffix);
+
+	return other.size() == length + suffixLength && other.compare(length, suffixLength, suffix) == 0;
+}
+
 std::string UserType::toDeclarationString()
 {
 	std::stringstream ss;
@@ -185,13 +246,13 @@ std::string UserType::toNameString(bool includeSize, bool includeInheritances)
 	case UNION:
 	case STRUCT:
 	case CLASS:
-		return classData->toNameString(name, includeSize, includeInheritances);
+		return classData->toNameString(getName(), includeSize, includeInheritances);
 	case ENUM:
-		return enumData->toNameString(name);
+		return enumData->toNameString(getName());
 	case ARRAY:
-		return arrayData->toNameString(name);
+		return arrayData->toNameString(getName());
 	case FUNCTION:
-		return functionData->toNameString(name);
+		return functionData->toNameString(getName());
 	}
 
 	return "<unknown user type (" + toHexString(type) + ")>";
@@ -285,7 +346,7 @@ std::string ClassType::Member::toString(bool includeOffset)
 	if (includeOffset)
 		ss << StarCommentToString(toHexString(offset), false) << " ";
 
-	ss << type.toString(name);
+	ss << type.toString(std::string(name));
 	if (bit_size != -1)
 		ss << " : " << bit_size;
 
@@ -381,7 +442,7 @@ std::string FunctionType::toParametersString()
 
 std::string FunctionType::Parameter::toString()
 {
-	return type.toString(name);
+	return type.toString(std::string(name));
 }
 
 std::string Function::toNameString(bool skipNamespace)
@@ -389,7 +450,7 @@ std::string Function::toNameString(bool skipNamespace)
 	std::stringstream ss;
 	ss << returnType.toString() << " ";
 	if (typeOwner != nullptr && !skipNamespace)
-		ss << typeOwner->name << "::";
+		ss << typeOwner->getName() << "::";
 	ss << name << toParametersString();
 	return ss.str();
 }
@@ -406,11 +467,16 @@ std::string Function::toDeclarationString()
 	return ss.str();
 }
 
-std::string Function::toDefinitionString()
+std::string Function::toDefinitionString(Demangler &demangler)
 {
 	std::stringstream ss;
-	ss << CommentToString(mangledName) <<
-		CommentToString("Start address: " + toHexString(startAddress)) <<
+	ss << CommentToString(std::string(mangledName));
+
+	// The full signature, with the parameters DWARF may have left out
+	if (const Demangler::Result *demangled = demangler.demangle(mangledName))
+		ss << CommentToString(demangled->toString());
+
+	ss << CommentToString("Start address: " + toHexString(startAddress)) <<
 		toNameString() << "\n{\n";
 
 	for (Variable &v : variables)
@@ -418,22 +484,21 @@ std::string Function::toDefinitionString()
 
 	// Save line numbers.
 	if (dwarf != nullptr) {
-		std::multimap<int, Dwarf::LineEntry>::iterator lines = dwarf->lineEntryMap.find(startAddress);
-		if (lines != dwarf->lineEntryMap.end()) {
-			std::pair<std::multimap<int, Dwarf::LineEntry>::iterator, std::multimap<int, Dwarf::LineEntry>::iterator> ret;
-			ret = dwarf->lineEntryMap.equal_range(startAddress);
-			for (std::multimap<int, Dwarf::LineEntry>::iterator it = ret.first; it != ret.second; ++it) {
+		const Dwarf::LineTable &lines = dwarf->lineTable;
+		std::pair<const Dwarf::LineTable::Chunk*, const Dwarf::LineTable::Chunk*> chunks = lines.findChunks(startAddress);
+		for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk) {
+			for (size_t i = chunk->begin; i < chunk->end; i++) {
 				ss << "\t// ";
-				if (it->second.lineNumber != 0) {
-					ss << "Line " << it->second.lineNumber;
+				if (lines.lineNumber[i] != 0) {
+					ss << "Line " << lines.lineNumber[i];
 				}
 				else {
 					ss << "Func End";
 				}
-				
-				if (it->second.charOffset != (short)-1)
-					ss << ", Character " << it->second.charOffset;
-				ss << ", Address: " << toHexString(startAddress + it->second.hexAddressOffset) << ", Func Offset: " << toHexString(it->second.hexAddressOffset) << "\n";
+
+				if (lines.charOffset[i] != (short)-1)
+					ss << ", Character " << lines.charOffset[i];
+				ss << ", Address: " << toHexString(startAddress + lines.addressOffset[i]) << ", Func Offset: " << toHexString(lines.addressOffset[i]) << "\n";
 			}
 		}
 	}
@@ -574,40 +639,6 @@ int GetFundamentalTypeSize(FundamentalType ft)
 	return -1;
 }
 
-int Type::size() {
-	if (modifiers.size() > 0)
-		for (Cpp::Type::Modifier modifier : modifiers)
-			if (modifier == Cpp::Type::Modifier::POINTER_TO || modifier == Cpp::Type::Modifier::REFERENCE_TO)
-				return 4;
-
-	if (isFundamentalType) {
-		return GetFundamentalTypeSize(fundamentalType);
-	}
-	else {
-		switch (userType->type) {
-		case Cpp::UserType::STRUCT:
-		case Cpp::UserType::CLASS:
-		case Cpp::UserType::UNION:
-			return userType->classData->size;
-			break;
-		case Cpp::UserType::ARRAY:
-			int amount;
-			amount = 1;
-			if (userType->arrayData->dimensions.size() > 0)
-				for (auto dimension : userType->arrayData->dimensions)
-					amount *= dimension.size;
-			return amount * userType->arrayData->type.size();
-			break;
-		case Cpp::UserType::FUNCTION:
-			return 4;
-			break;
-		case Cpp::UserType::ENUM:
-			return GetFundamentalTypeSize(userType->enumData->baseType);
-			break;
-		}
-	}
-}
-
 std::string Type::ModifierToString(Modifier m)
 {
 	switch (m)
@@ -627,6 +658,14 @@ std::string Type::ModifierToString(Modifier m)
 	return ss.str();
 }
 
+// '@' can't appear in C++ names; unnamed classes like "@class$12" are written as "_class$12"
+std::string SanitizeName(std::string_view name)
+{
+	std::string result(name);
+	std::replace(result.begin(), result.end(), '@', '_');
+	return result;
+}
+
 std::string CommentToString(std::string comment)
 {
 	return "// " + comment + "\n";
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "dwarf.h"
+#include <functional>
 #include <vector>
 #include <map>
 #include <string>
+#include <string_view>
 #include <sstream>
 
+class Demangler;
+
 namespace Cpp
 {
 struct File;
@@ -17,6 +21,7 @@ struct EnumType;
 struct ArrayType;
 struct FunctionType;
 struct Function;
+struct LexicalBlock;
 
 enum FundamentalType
 {
@@ -58,7 +63,7 @@ enum FundamentalType
 
 struct File
 {
-	std::string filename;
+	std::string_view filename;
 	std::vector<Variable> variables;
 	std::vector<UserType*> userTypes;
 	std::vector<Function> functions;
@@ -85,7 +90,11 @@ struct Type
 		UserType *userType;
 	};
 
+	// Size and alignment in bytes, -1 if unknown. O(1) once the user type's
+	// layout has been computed.
 	int size();
+	int alignment();
+	bool isIndirect();
 	std::string toString(std::string varName);
 	std::string toString();
 	static std::string ModifierToString(Modifier m);
@@ -93,7 +102,7 @@ struct Type
 
 struct Variable
 {
-	std::string name;
+	std::string_view name;
 	bool isGlobal;
 	Type type;
 
@@ -103,17 +112,40 @@ struct Variable
 struct UserType
 {
 	enum { CLASS, UNION, STRUCT, ENUM, ARRAY, FUNCTION } type;
-	std::string name;
+	std::string_view name; // As written in the DWARF data
 	int index;
+	Elf32_Off offset; // Of the DWARF entry, which makes it a stable ID
+
+	// Set when the compile unit has been converted: the index among the
+	// unit's types with the same name if there are several, or NO_SUFFIX
+	enum { NAME_PENDING = -2, NO_SUFFIX = -1 };
+	int nameSuffix = NAME_PENDING;
 
+	// Filled in by computeLayout(); -1 if unknown
+	enum LayoutState { LAYOUT_PENDING, LAYOUT_IN_PROGRESS, LAYOUT_DONE };
+	LayoutState layoutState = LAYOUT_PENDING;
+	int layoutSize = -1;
+	int layoutAlignment = -1;
+
+	// Null until the type's entry is converted; placeholders have none
 	union
 	{
-		ClassType *classData;
+		ClassType *classData = nullptr;
 		EnumType *enumData;
 		ArrayType *arrayData;
 		FunctionType *functionData;
 	};
 
+	UserType() = default;
+	~UserType();
+
+	UserType(const UserType&) = delete;
+	UserType& operator=(const UserType&) = delete;
+
+	// The name used in the output, e.g. "type_2" for the third unnamed type
+	std::string getName();
+	bool hasName(const std::string &other);
+
 	std::string toDeclarationString();
 	std::string toDefinitionString(bool includeComments);
 	std::string toNameString(bool includeSize, bool includeInheritances);
@@ -124,11 +156,15 @@ struct ClassType
 	struct Member
 	{
 		int offset;
-		std::string name;
+		std::string_view name;
 		Type type;
 		int bit_offset;
 		int bit_size;
 
+		// Filled in by computeLayout(): unused bytes between the end of
+		// everything before this member and the member's offset
+		int padding = 0;
+
 		std::string toString(bool includeOffset);
 	};
 
@@ -143,6 +179,7 @@ struct ClassType
 	std::vector<Member> members;
 	std::vector<Inheritance> inheritances;
 	std::vector<Function> functions;
+	int tailPadding = 0; // Unused bytes after the last member, filled in by computeLayout()
 
 	std::string toNameString(std::string name, bool includeSize, bool includeInheritances);
 	std::string toBodyString(bool includeOffsets);
@@ -153,7 +190,7 @@ struct EnumType
 {
 	struct Element
 	{
-		std::string name;
+		std::string_view name;
 		long constValue;
 
 		std::string toString(int lastValue);
@@ -183,7 +220,7 @@ struct FunctionType
 {
 	struct Parameter
 	{
-		std::string name;
+		std::string_view name;
 		Type type;
 
 		std::string toString();
@@ -196,25 +233,50 @@ struct FunctionType
 	std::string toParametersString();
 };
 
+struct LexicalBlock
+{
+	unsigned int startAddress;
+	unsigned int endAddress;
+	std::vector<Variable> variables;
+	std::vector<LexicalBlock> blocks;
+};
+
 struct Function : FunctionType
 {
 
 	bool isGlobal;
-	std::string name;
-	std::string mangledName;
+	std::string_view name;
+	std::string_view mangledName;
 	unsigned int startAddress;
+	unsigned int endAddress; // One past the last instruction, 0 if unknown
 	std::vector<Variable> variables;
+	std::vector<LexicalBlock> blocks; // Lexical blocks with their nesting kept
 	UserType* typeOwner;
 	Dwarf* dwarf;
 
 	std::string toNameString();
 	std::string toNameString(bool skipNamespace);
 	std::string toDeclarationString();
-	std::string toDefinitionString();
+
+	// `demangler` keeps every name it demangled, so the caller decides how
+	// long they are cached
+	std::string toDefinitionString(Demangler &demangler);
 };
 
 std::string FundamentalTypeToString(FundamentalType ft);
+std::string SanitizeName(std::string_view name);
 int GetFundamentalTypeSize(FundamentalType ft);
+
+// Computes the size, alignment and member padding of a user type and of
+// every type it contains, once. Not thread-safe; run computeLayouts() over all
+// user types before reading sizes from several threads.
+void computeLayout(UserType *ut);
+void computeLayouts(const std::vector<UserType*> &userTypes);
+
+// Drops the user types of a file that none of its variables and functions
+// use, directly or through other types. Types isRoot() accepts are kept
+// along with what they use.
+void removeUnreachableTypes(File *file, const std::function<bool(UserType*)> &isRoot);
 std::string CommentToString(std::string comment);
 std::string StarCommentToString(std::string comment, bool multiline);
 std::string IndentToString(int level);
@@ -0,0 +1,761 @@
+#include "demangle.h"
+
+#include <cctype>
+
+// Fundamental types by their code letter, starting at 'a'
+static const char *const fundamentalTypes[26] = {
+	nullptr,       // a
+	"bool",        // b
+	"char",        // c
+	"double",      // d
+	"...",         // e
+	"float",       // f
+	nullptr,       // g
+	nullptr,       // h
+	"int",         // i
+	nullptr,       // j
+	nullptr,       // k
+	"long",        // l
+	nullptr,       // m
+	nullptr,       // n
+	nullptr,       // o
+	nullptr,       // p
+	nullptr,       // q
+	"long double", // r
+	"short",       // s
+	nullptr,       // t, a template class
+	nullptr,       // u
+	"void",        // v
+	"wchar_t",     // w
+	"long long",   // x
+	nullptr,       // y
+	nullptr        // z
+};
+
+struct OperatorName
+{
+	const char *code;
+	const char *name;
+};
+
+// Operator function names, "__pl" etc. GCC 2.x spells *= as "aml", CodeWarrior as "amu".
+static const OperatorName operatorNames[] = {
+	{ "aa", "operator&&" },
+	{ "aad", "operator&=" },
+	{ "ad", "operator&" },
+	{ "adv", "operator/=" },
+	{ "aer", "operator^=" },
+	{ "als", "operator<<=" },
+	{ "amd", "operator%=" },
+	{ "ami", "operator-=" },
+	{ "aml", "operator*=" },
+	{ "amu", "operator*=" },
+	{ "aor", "operator|=" },
+	{ "apl", "operator+=" },
+	{ "ars", "operator>>=" },
+	{ "as", "operator=" },
+	{ "cl", "operator()" },
+	{ "cm", "operator," },
+	{ "co", "operator~" },
+	{ "dl", "operator delete" },
+	{ "dla", "operator delete[]" },
+	{ "dv", "operator/" },
+	{ "eq", "operator==" },
+	{ "er", "operator^" },
+	{ "ge", "operator>=" },
+	{ "gt", "operator>" },
+	{ "le", "operator<=" },
+	{ "ls", "operator<<" },
+	{ "lt", "operator<" },
+	{ "md", "operator%" },
+	{ "mi", "operator-" },
+	{ "ml", "operator*" },
+	{ "mm", "operator--" },
+	{ "ne", "operator!=" },
+	{ "nt", "operator!" },
+	{ "nw", "operator new" },
+	{ "nwa", "operator new[]" },
+	{ "oo", "operator||" },
+	{ "or", "operator|" },
+	{ "pl", "operator+" },
+	{ "pp", "operator++" },
+	{ "rf", "operator->" },
+	{ "rm", "operator->*" },
+	{ "rs", "operator>>" },
+	{ "vc", "operator[]" }
+};
+
+static inline bool isClassStart(char c)
+{
+	return (c >= '1' && c <= '9') || c == 'Q' || c == 't';
+}
+
+// "Foo<int>" -> "Foo", for constructor and destructor names
+static std::string_view stripTemplateArguments(std::string_view name)
+{
+	return name.substr(0, name.find('<'));
+}
+
+static std::string joinTypes(const std::vector<std::string_view> &types)
+{
+	std::string str;
+
+	for (size_t i = 0; i < types.size(); i++)
+	{
+		if (i > 0)
+			str += ", ";
+
+		str += types[i];
+	}
+
+	return str;
+}
+
+std::string Demangler::Result::toString() const
+{
+	std::string str = (kind == VTABLE) ? "vtable for " : "";
+
+	for (size_t i = 0; i < scopes.size(); i++)
+	{
+		if (i > 0)
+			str += "::";
+
+		str += scopes[i];
+	}
+
+	if (kind == VTABLE)
+		return str;
+
+	if (!scopes.empty())
+		str += "::";
+
+	str += name;
+	str += '(';
+	str += joinTypes(parameters);
+	str += ')';
+
+	if (isConst)
+		str += " const";
+
+	return str;
+}
+
+const Demangler::Result* Demangler::demangle(std::string_view mangled)
+{
+	if (mangled.empty())
+		return nullptr;
+
+	const char *key = m_pool.intern(mangled);
+	auto it = m_results.find(key);
+
+	if (it != m_results.end())
+		return it->second.get();
+
+	std::unique_ptr<Result> result(new Result);
+
+	if (!parseFunction(mangled, result.get()))
+		result.reset();
+
+	return (m_results[key] = std::move(result)).get();
+}
+
+void Demangler::clear()
+{
+	m_results.clear();
+	m_classes.clear();
+	m_types.clear();
+	m_pool.clear();
+}
+
+bool Demangler::parseFunction(std::string_view mangled, Result *result)
+{
+	m_input = mangled;
+	result->kind = Result::FUNCTION;
+
+	// Virtual tables: __vt__<class> in CodeWarrior, _vt$<class> or _vt.<class> in GCC 2.x
+	size_t vtablePrefix = 0;
+
+	if (mangled.substr(0, 6) == "__vt__")
+		vtablePrefix = 6;
+	else if (mangled.substr(0, 4) == "_vt$" || mangled.substr(0, 4) == "_vt.")
+		vtablePrefix = 4;
+
+	m_pos = vtablePrefix;
+
+	if (vtablePrefix != 0 && isClassStart(peek()))
+	{
+		const ClassName *owner = parseClass();
+
+		if (owner && m_pos == mangled.size())
+		{
+			result->kind = Result::VTABLE;
+			result->scopes = owner->scopes;
+			result->name = std::string_view();
+			result->parameters.clear();
+			result->isConst = false;
+			return true;
+		}
+	}
+
+	// GCC 2.x destructors: _$_<class> or _._<class>
+	if (mangled.size() > 3 && mangled[0] == '_' && (mangled[1] == '$' || mangled[1] == '.') && mangled[2] == '_')
+	{
+		m_pos = 3;
+
+		const ClassName *owner = parseClass();
+
+		if (!owner || m_pos != mangled.size())
+			return false;
+
+		result->scopes = owner->scopes;
+		result->parameters.clear();
+		result->isConst = false;
+
+		return parseSpecialName("__dt", result);
+	}
+
+	// GCC 2.x constructors: __<class><parameters>
+	if (mangled.size() > 2 && mangled[0] == '_' && mangled[1] == '_' && isClassStart(mangled[2]) && parseSignature("__ct", 2, result))
+		return true;
+
+	// <name>__<signature>. The name may contain "__" itself, so the first
+	// split that leaves a valid signature wins.
+	for (size_t p = 1; p + 2 < mangled.size(); p++)
+	{
+		if (mangled[p] == '_' && mangled[p + 1] == '_' && parseSignature(mangled.substr(0, p), p + 2, result))
+			return true;
+	}
+
+	return false;
+}
+
+bool Demangler::parseSignature(std::string_view name, size_t pos, Result *result)
+{
+	m_pos = pos;
+	m_types.clear();
+	result->scopes.clear();
+	result->parameters.clear();
+	result->isConst = false;
+
+	// GCC 2.x marks const member functions before the class
+	if (peek() == 'C' && isClassStart(peek(1)))
+	{
+		result->isConst = true;
+		m_pos++;
+	}
+
+	if (isClassStart(peek()))
+	{
+		const ClassName *owner = parseClass();
+
+		if (!owner)
+			return false;
+
+		result->scopes = owner->scopes;
+
+		// GCC 2.x back references count the class as the first type
+		m_types.push_back(owner->qualifiedName);
+
+		// CodeWarrior marks const member functions before the F
+		if (peek() == 'C' && peek(1) == 'F')
+		{
+			result->isConst = true;
+			m_pos++;
+		}
+
+		if (peek() == 'F')
+			m_pos++;
+	}
+	else if (peek() == 'F')
+		m_pos++;
+	else
+		return false;
+
+	if (!parseParameters('\0', &result->parameters, true) || m_pos != m_input.size())
+		return false;
+
+	return parseSpecialName(name, result);
+}
+
+// Turns constructor, destructor and operator names into what they are in the source
+bool Demangler::parseSpecialName(std::string_view name, Result *result)
+{
+	if (name.size() <= 2 || name[0] != '_' || name[1] != '_')
+	{
+		result->name = intern(name);
+		return true;
+	}
+
+	std::string_view code = name.substr(2);
+	std::string_view owner = stripTemplateArguments(result->getOwner());
+
+	if (code == "ct" || code == "dt")
+	{
+		if (owner.empty())
+			return false;
+
+		result->name = intern((code == "dt") ? "~" + std::string(owner) : std::string(owner));
+		return true;
+	}
+
+	if (code.size() > 2 && code.substr(0, 2) == "op")
+	{
+		// Conversion operator, followed by the encoded type
+		std::string_view input = m_input;
+		std::string type;
+
+		m_input = code.substr(2);
+		m_pos = 0;
+
+		bool success = parseType(&type) && m_pos == m_input.size();
+
+		m_input = input;
+
+		if (!success)
+			return false;
+
+		result->name = intern("operator " + type);
+		return true;
+	}
+
+	for (const OperatorName &op : operatorNames)
+	{
+		if (code == op.code)
+		{
+			result->name = op.name;
+			return true;
+		}
+	}
+
+	result->name = intern(name);
+	return true;
+}
+
+// Parses types up to `terminator`, or the end of the name for '\0'. With
+// `remember`, they become the targets of GCC 2.x back references.
+bool Demangler::parseParameters(char terminator, std::vector<std::string_view> *parameters, bool remember)
+{
+	// A lone v is (void)
+	if (peek() == 'v' && peek(1) == terminator)
+	{
+		m_pos++;
+		return true;
+	}
+
+	std::string type;
+
+	while (peek() != terminator)
+	{
+		if (peek() == '\0')
+			return false;
+
+		// GCC 2.x back references: T<index> repeats an earlier type, and
+		// N<count><index> repeats it several times
+		if (peek() == 'T' || peek() == 'N')
+		{
+			size_t count = 1;
+			size_t index;
+
+			if (m_input[m_pos++] == 'N' && !readIndex(&count))
+				return false;
+
+			if (!readIndex(&index) || index >= m_types.size())
+				return false;
+
+			parameters->insert(parameters->end(), count, m_types[index]);
+			continue;
+		}
+
+		if (!parseType(&type))
+			return false;
+
+		std::string_view interned = intern(type);
+
+		parameters->push_back(interned);
+
+		if (remember)
+			m_types.push_back(interned);
+	}
+
+	return true;
+}
+
+bool Demangler::parseType(std::string *out)
+{
+	std::string right;
+	bool isFunctionOrArray;
+
+	if (!parseType(out, &right, &isFunctionOrArray))
+		return false;
+
+	*out += right;
+	return true;
+}
+
+// Parses a type as the text to the left and to the right of where a
+// declarator goes, like "void (*" and ")(int)" for a pointer to function, so
+// that pointers and arrays of it can nest their declarators inside.
+// `isFunctionOrArray` tells whether a pointer to the type needs parentheses.
+bool Demangler::parseType(std::string *left, std::string *right, bool *isFunctionOrArray)
+{
+	bool isConst = false;
+	bool isVolatile = false;
+	const char *sign = "";
+
+	for (;; m_pos++)
+	{
+		char c = peek();
+
+		if (c == 'C')
+			isConst = true;
+		else if (c == 'V')
+			isVolatile = true;
+		else if (c == 'U')
+			sign = "unsigned ";
+		else if (c == 'S')
+			sign = "signed ";
+		else
+			break;
+	}
+
+	const char *qualifiers = nullptr;
+
+	if (isConst)
+		qualifiers = isVolatile ? "const volatile" : "const";
+	else if (isVolatile)
+		qualifiers = "volatile";
+
+	char c = peek();
+
+	right->clear();
+	*isFunctionOrArray = false;
+
+	switch (c)
+	{
+	case 'P':
+	case 'R':
+	case 'M':
+	{
+		m_pos++;
+
+		std::string declarator = (c == 'R') ? "&" : "*";
+
+		// Pointer to member: M<class><type>
+		if (c == 'M')
+		{
+			const ClassName *cls = parseClass();
+
+			if (!cls)
+				return false;
+
+			declarator = std::string(cls->qualifiedName) + "::*";
+		}
+
+		bool isInnerFunctionOrArray;
+
+		if (!parseType(left, right, &isInnerFunctionOrArray))
+			return false;
+
+		if (isInnerFunctionOrArray)
+		{
+			// "int (*)(char)", "int (zScene::*)[4]"
+			if (!left->empty() && (isalnum((unsigned char)left->back()) || left->back() == '_' || left->back() == '>'))
+				*left += ' ';
+
+			*left += '(';
+			*left += declarator;
+			right->insert(0, 1, ')');
+		}
+		else
+		{
+			// "int*", "int zScene::*", and nested in a pointer to function "void (* zScene::*)()"
+			if (c == 'M')
+				*left += ' ';
+
+			*left += declarator;
+		}
+
+		// A const pointer, not a pointer to const
+		if (qualifiers)
+		{
+			*left += ' ';
+			*left += qualifiers;
+		}
+
+		return true;
+	}
+	case 'A':
+	{
+		size_t size;
+
+		m_pos++;
+
+		if (!readNumber(&size) || peek() != '_')
+			return false;
+
+		m_pos++;
+
+		bool isElementFunctionOrArray;
+
+		if (!parseType(left, right, &isElementFunctionOrArray))
+			return false;
+
+		// "int[2][4]", and "void (*[2])()" for an array of pointers to functions
+		right->insert(0, "[" + std::to_string(size) + "]");
+		*isFunctionOrArray = true;
+		return true;
+	}
+	case 'F':
+	{
+		// F<parameters>_<return type>; a const member function type has a C before the F
+		std::vector<std::string_view> types;
+
+		m_pos++;
+
+		if (!parseParameters('_', &types, false))
+			return false;
+
+		m_pos++;
+
+		bool isReturnFunctionOrArray;
+
+		if (!parseType(left, right, &isReturnFunctionOrArray))
+			return false;
+
+		std::string parameters = "(" + joinTypes(types) + ")";
+
+		if (qualifiers)
+		{
+			parameters += ' ';
+			parameters += qualifiers;
+		}
+
+		// "void (int)", or inside the declarator of a returned pointer to function
+		if (right->empty())
+			*left += ' ';
+
+		right->insert(0, parameters);
+		*isFunctionOrArray = true;
+		return true;
+	}
+	}
+
+	std::string_view base;
+
+	if (isClassStart(c))
+	{
+		const ClassName *cls = parseClass();
+
+		if (!cls)
+			return false;
+
+		base = cls->qualifiedName;
+	}
+	else if (c >= 'a' && c <= 'z' && fundamentalTypes[c - 'a'])
+	{
+		base = fundamentalTypes[c - 'a'];
+		m_pos++;
+	}
+	else
+		return false;
+
+	left->clear();
+
+	if (qualifiers)
+	{
+		*left += qualifiers;
+		*left += ' ';
+	}
+
+	*left += sign;
+	*left += base;
+
+	return true;
+}
+
+// Parses a possibly qualified class name. Every distinct encoding is decoded
+// once; after that it is only measured and looked up.
+const Demangler::ClassName* Demangler::parseClass()
+{
+	size_t start = m_pos;
+
+	if (!readClass(nullptr))
+		return nullptr;
+
+	const char *key = m_pool.intern(m_input.substr(start, m_pos - start));
+	auto it = m_classes.find(key);
+
+	if (it != m_classes.end())
+		return &it->second;
+
+	size_t end = m_pos;
+	ClassName cls;
+
+	m_pos = start;
+
+	if (!readClass(&cls.scopes))
+		return nullptr;
+
+	std::string qualifiedName;
+
+	for (size_t i = 0; i < cls.scopes.size(); i++)
+	{
+		if (i > 0)
+			qualifiedName += "::";
+
+		qualifiedName += cls.scopes[i];
+	}
+
+	cls.qualifiedName = intern(qualifiedName);
+	m_pos = end;
+
+	return &m_classes.emplace(key, std::move(cls)).first->second;
+}
+
+// Reads <component> or Q<count><component>..., adding the components to
+// `scopes` unless it is null
+bool Demangler::readClass(std::vector<std::string_view> *scopes)
+{
+	if (peek() != 'Q')
+		return readComponent(scopes);
+
+	size_t count;
+
+	m_pos++;
+
+	if (!readIndex(&count) || count == 0)
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!readComponent(scopes))
+			return false;
+	}
+
+	return true;
+}
+
+// Reads <length><name>, or a GCC 2.x template instance t<length><name><count><arguments>
+bool Demangler::readComponent(std::vector<std::string_view> *scopes)
+{
+	bool isTemplate = (peek() == 't');
+
+	if (isTemplate)
+		m_pos++;
+
+	size_t length;
+
+	if (!readNumber(&length) || length == 0 || length > m_input.size() - m_pos)
+		return false;
+
+	std::string_view name = m_input.substr(m_pos, length);
+
+	m_pos += length;
+
+	if (!isTemplate)
+	{
+		if (scopes)
+			scopes->push_back(intern(name));
+
+		return true;
+	}
+
+	size_t count;
+
+	if (!readNumber(&count))
+		return false;
+
+	std::string instance(name);
+	instance += '<';
+
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string argument;
+
+		if (i > 0)
+			instance += ", ";
+
+		if (peek() == 'Z')
+		{
+			// A type argument
+			m_pos++;
+
+			if (!parseType(&argument))
+				return false;
+		}
+		else
+		{
+			// A value of an integral type: the type, then the value with m for minus
+			size_t value;
+
+			if (!parseType(&argument))
+				return false;
+
+			argument.clear();
+
+			if (peek() == 'm')
+			{
+				argument = "-";
+				m_pos++;
+			}
+
+			if (!readNumber(&value))
+				return false;
+
+			argument += std::to_string(value);
+		}
+
+		instance += argument;
+	}
+
+	if (instance.back() == '>')
+		instance += ' ';
+
+	instance += '>';
+
+	if (scopes)
+		scopes->push_back(intern(instance));
+
+	return true;
+}
+
+bool Demangler::readNumber(size_t *value)
+{
+	size_t start = m_pos;
+
+	*value = 0;
+
+	while (peek() >= '0' && peek() <= '9')
+	{
+		*value = *value * 10 + (peek() - '0');
+		m_pos++;
+
+		// No count or length is longer than the name itself
+		if (*value > m_input.size())
+			return false;
+	}
+
+	return m_pos > start;
+}
+
+// Reads a single digit, or a longer number as _<number>_
+bool Demangler::readIndex(size_t *value)
+{
+	if (peek() >= '0' && peek() <= '9')
+	{
+		*value = peek() - '0';
+		m_pos++;
+		return true;
+	}
+
+	if (peek() != '_')
+		return false;
+
+	m_pos++;
+
+	if (!readNumber(value) || peek() != '_')
+		return false;
+
+	m_pos++;
+	return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "string_pool.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Demangles function names of the CodeWarrior and GCC 2.x ABIs. Both encode a
+// function as <name>__<class><parameter types>: "Update__6zSceneFf" is
+// zScene::Update(float) in CodeWarrior, which puts an F before the parameters
+// of member functions, and "Update__6zScenef" is the same in GCC 2.x.
+// Virtual tables, "__vt__6zScene" and "_vt$6zScene", are recognized as well.
+//
+// Every result is memoized by mangled name, and every decoded class by its
+// encoding, so functions of a class already seen cost a few table lookups.
+// Not thread-safe; use one demangler per thread.
+class Demangler
+{
+public:
+	struct Result
+	{
+		enum Kind
+		{
+			FUNCTION,
+			VTABLE // The virtual table of the class in `scopes`; no name or parameters
+		};
+
+		Kind kind;
+		std::vector<std::string_view> scopes;     // Enclosing namespaces and classes, outermost first
+		std::string_view name;                    // "Update", "operator+=", "~zScene"
+		std::vector<std::string_view> parameters; // Parameter types without `this`; empty for (void)
+		bool isConst;                             // A const member function
+
+		// The innermost class, or an empty string for free functions
+		std::string_view getOwner() const
+		{
+			return scopes.empty() ? std::string_view() : scopes.back();
+		}
+
+		// "zScene::Update(float)", or "vtable for zScene"
+		std::string toString() const;
+	};
+
+	// Returns nullptr if `mangled` isn't a function or virtual table name of
+	// either ABI. The result stays valid until clear() or the demangler is
+	// destroyed.
+	const Result* demangle(std::string_view mangled);
+
+	void clear();
+
+private:
+	StringPool m_pool; // Every string results point to
+
+	// By interned mangled name; null for names that don't demangle
+	std::unordered_map<const char*, std::unique_ptr<Result>> m_results;
+
+	struct ClassName
+	{
+		std::vector<std::string_view> scopes;
+		std::string_view qualifiedName; // "Foo::Bar"
+	};
+
+	// Decoded classes by interned encoding, e.g. "Q23Foo3Bar"
+	std::unordered_map<const char*, ClassName> m_classes;
+
+	// The name being parsed
+	std::string_view m_input;
+	size_t m_pos;
+	std::vector<std::string_view> m_types; // Types for GCC 2.x back references
+
+	inline char peek(size_t ahead = 0) const
+	{
+		return (m_pos + ahead < m_input.size()) ? m_input[m_pos + ahead] : '\0';
+	}
+
+	inline std::string_view intern(std::string_view str)
+	{
+		return std::string_view(m_pool.intern(str), str.size());
+	}
+
+	bool parseFunction(std::string_view mangled, Result *result);
+	bool parseSignature(std::string_view name, size_t pos, Result *result);
+	bool parseSpecialName(std::string_view name, Result *result);
+	bool parseParameters(char terminator, std::vector<std::string_view> *parameters, bool remember);
+	bool parseType(std::string *out);
+	bool parseType(std::string *left, std::string *right, bool *isFunctionOrArray);
+	const ClassName* parseClass();
+	bool readClass(std::vector<std::string_view> *scopes);
+	bool readComponent(std::vector<std::string_view> *scopes);
+	bool readNumber(size_t *value);
+	bool readIndex(size_t *value);
+};
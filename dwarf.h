@@ -1,11 +1,15 @@
 #pragma once
 
 #include "elf.h"
+#include "bulk_decode.h"
 
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <string>
 #include <vector>
 #include <iostream>
-#include <unordered_map>
+#include <thread>
 
 #define DW_TAG_padding                0x0000
 #define DW_TAG_array_type             0x0001
@@ -267,6 +271,55 @@ public:
 	struct Attribute;
 	struct Entry;
 
+	// Attributes whose position in an entry is recorded when it is parsed,
+	// so that Entry::get finds them without scanning. SLOT_TYPE holds the
+	// first of the four type attributes.
+	enum AttributeSlot
+	{
+		SLOT_NAME,
+		SLOT_SIBLING,
+		SLOT_TYPE,
+		SLOT_BYTE_SIZE,
+		SLOT_LOCATION,
+		SLOT_LOW_PC,
+		SLOT_HIGH_PC,
+		SLOT_COUNT
+	};
+
+	static inline int getAttributeSlot(Elf32_Half name)
+	{
+		switch (name)
+		{
+		case DW_AT_name:
+			return SLOT_NAME;
+		case DW_AT_sibling:
+			return SLOT_SIBLING;
+		case DW_AT_fund_type:
+		case DW_AT_mod_fund_type:
+		case DW_AT_user_def_type:
+		case DW_AT_mod_u_d_type:
+			return SLOT_TYPE;
+		case DW_AT_byte_size:
+			return SLOT_BYTE_SIZE;
+		case DW_AT_location:
+			return SLOT_LOCATION;
+		case DW_AT_low_pc:
+			return SLOT_LOW_PC;
+		case DW_AT_high_pc:
+			return SLOT_HIGH_PC;
+		}
+
+		return -1;
+	}
+
+	// Bit of Entry::attributeMask for an attribute. Standard attribute ids
+	// (name >> 4) are all below 64; bit 0 stands for every other id.
+	static inline uint64_t getAttributeBit(Elf32_Half name)
+	{
+		unsigned id = name >> 4;
+		return 1ull << ((id < 64) ? id : 0);
+	}
+
 	struct Attribute
 	{
 		Dwarf* dwarf;
@@ -274,7 +327,7 @@ public:
 		Elf32_Off offset;
 		Elf32_Half name;
 		Elf32_Word size;
-		void *value;
+		const void *value;
 
 		inline Elf32_Half getForm()
 		{
@@ -291,9 +344,9 @@ public:
 			return dwarf->read<Elf32_Off>(value);
 		}
 
-		inline char* getBlock()
+		inline const char* getBlock()
 		{
-			return (char*)value;
+			return (const char*)value;
 		}
 
 		inline Elf32_Half getHword()
@@ -311,9 +364,9 @@ public:
 			return dwarf->read<uint64_t>(value);
 		}
 
-		inline char* getString()
+		inline const char* getString()
 		{
-			return (char*)value;
+			return (const char*)value;
 		}
 	};
 
@@ -326,49 +379,155 @@ public:
 		Elf32_Half tag;
 		std::vector<Attribute> attributes;
 
+		uint64_t attributeMask;          // getAttributeBit() of every attribute present
+		unsigned char slots[SLOT_COUNT]; // Index into `attributes` per AttributeSlot, or NO_SLOT
+
+		static constexpr unsigned char NO_SLOT = 0xff;
+
+		Entry() : attributeMask(0)
+		{
+			std::fill(slots, slots + SLOT_COUNT, NO_SLOT);
+		}
+
 		inline bool isNullEntry()
 		{
 			return length < 8;
 		}
 
+		// Records an attribute just appended to `attributes`
+		inline void indexAttribute(size_t i)
+		{
+			Elf32_Half name = attributes[i].name;
+			int slot = getAttributeSlot(name);
+
+			attributeMask |= getAttributeBit(name);
+
+			if (slot >= 0 && slots[slot] == NO_SLOT && i < NO_SLOT)
+				slots[slot] = (unsigned char)i;
+		}
+
+		inline bool hasAttribute(Elf32_Half name) const
+		{
+			return (attributeMask & getAttributeBit(name)) != 0;
+		}
+
+		// The first attribute called `name`, or nullptr. Constant time for
+		// slotted and absent attributes; others are found by a scan.
+		inline Attribute* get(Elf32_Half name)
+		{
+			int slot = getAttributeSlot(name);
+
+			if (slot >= 0 && slots[slot] != NO_SLOT && attributes[slots[slot]].name == name)
+				return &attributes[slots[slot]];
+
+			if (!hasAttribute(name))
+				return nullptr;
+
+			for (Attribute &attr : attributes)
+			{
+				if (attr.name == name)
+					return &attr;
+			}
+
+			return nullptr;
+		}
+
 		inline Entry* getSibling()
 		{
 			if (index == dwarf->entries.size() - 1)
 				return nullptr;
 
-			size_t numAttributes = attributes.size();
+			Attribute *attr = get(DW_AT_sibling);
 
-			for (size_t i = 0; i < numAttributes; i++)
+			if (attr)
 			{
-				Attribute *attr = &attributes[i];
+				Elf32_Off ref = attr->getReference();
 
-				if (attr->name == DW_AT_sibling)
-				{
-					Elf32_Off offset = attr->getReference();
-					Entry *sibling = dwarf->getEntryFromReference(offset);
+				// A reference past the last decoded entry, such as the end of
+				// the section or of a unit view, means there is no sibling
+				if (ref > dwarf->entries.back().offset)
+					return nullptr;
 
-					if (sibling)
-						return sibling;
+				// Unvalidated siblings may point backwards, which would loop
+				Entry *sibling = (dwarf->m_checked && ref <= offset) ? nullptr : dwarf->getEntryFromReference(ref);
 
-					break;
-				}
+				if (sibling)
+					return sibling;
 			}
 
 			return this + 1;
 		}
 	};
 
-	struct LineEntry
+	// Line number records from the .line section, decoded in bulk into columns.
+	// Each chunk covers the records of one function, keyed by its start address.
+	struct LineTable
 	{
-		int lineNumber;
-		short charOffset;
-		int hexAddressOffset;
+		struct Chunk
+		{
+			Elf32_Addr address;
+			size_t begin;
+			size_t end;
+		};
+
+		std::vector<Chunk> chunks; // Sorted by address, in section order for equal addresses
+		std::vector<int> lineNumber;
+		std::vector<short> charOffset;
+		std::vector<int> addressOffset;
+
+		// Returns the chunks whose records belong to the function starting at `address`
+		inline std::pair<const Chunk*, const Chunk*> findChunks(Elf32_Addr address) const
+		{
+			auto range = std::equal_range(chunks.begin(), chunks.end(), address, ChunkLess());
+			return std::make_pair(chunks.data() + (range.first - chunks.begin()), chunks.data() + (range.second - chunks.begin()));
+		}
+
+		struct ChunkLess
+		{
+			bool operator()(const Chunk &a, const Chunk &b) const { return a.address < b.address; }
+			bool operator()(const Chunk &a, Elf32_Addr b) const { return a.address < b; }
+			bool operator()(Elf32_Addr a, const Chunk &b) const { return a < b.address; }
+		};
 	};
 
-	std::multimap<int, LineEntry> lineEntryMap;
+	const LineTable &lineTable; // Shared by a Dwarf and its unit views
 	std::vector<Entry> entries;
 
-	Dwarf(ElfFile *elf)
+	// Byte range of one top-level entry together with its children, i.e.
+	// everything from the entry up to its DW_AT_sibling
+	struct Unit
+	{
+		Elf32_Off begin;
+		Elf32_Off end;
+		bool skipped; // Only the top-level entry was decoded, see UnitFilter
+	};
+
+	std::vector<Unit> units;
+
+	// The Dwarf a unit view was made from, or null
+	const Dwarf *parent = nullptr;
+
+	// A problem found while validating the section, see validateUnits
+	struct Diagnostic
+	{
+		Elf32_Off offset;
+		std::string message;
+	};
+
+	std::vector<Diagnostic> diagnostics; // The first few problems
+	size_t numProblems = 0;
+
+	// Decides from its DW_AT_name whether a compile unit is needed. The
+	// children of rejected compile units are never decoded, so they don't
+	// appear in `entries`; the compile unit entry itself still does.
+	typedef std::function<bool(const char *name)> UnitFilter;
+
+	// numThreads is the number of threads used to decode the section, 0 means
+	// one per hardware thread. Without decodeEntries, only `units` and the line
+	// table are read and `entries` stays empty; the units can then be decoded
+	// one at a time through unit views.
+	Dwarf(ElfFile *elf, unsigned numThreads = 0, const UnitFilter &unitFilter = nullptr, bool decodeEntries = true)
+		: lineTable(m_lineTable)
 	{
 		m_error = ERR_NONE;
 		m_elf = elf;
@@ -384,146 +543,633 @@ public:
 		m_sectionData = m_elf->getSectionData(m_section);
 		m_sectionSize = m_section->sh_size;
 
+		findUnits(unitFilter);
+
+		if (!m_error && decodeEntries)
+		{
+			validateUnits(numThreads);
+			readUnits(numThreads);
+		}
+
+		readLineTable();
+	}
+
+	// A view holding the entries of only one unit of `parent`. The view shares
+	// the parent's line table, so the parent must outlive it. The unit is
+	// decoded even if the UnitFilter skipped it.
+	Dwarf(const Dwarf &parent, size_t unitIndex)
+		: lineTable(parent.lineTable), parent(&parent)
+	{
+		m_error = ERR_NONE;
+		m_elf = parent.m_elf;
+		m_section = parent.m_section;
+		m_sectionData = parent.m_sectionData;
+		m_sectionSize = parent.m_sectionSize;
+
+		units.push_back(parent.units[unitIndex]);
+		units.back().skipped = false;
+		validateUnits(1);
+		readUnits(1);
+	}
+
+	Dwarf(const Dwarf&) = delete;
+	Dwarf& operator=(const Dwarf&) = delete;
+
+	// First phase: walk the sibling chain of the top-level entries to find
+	// independent byte ranges. Only the top-level entries themselves are decoded.
+	void findUnits(const UnitFilter &unitFilter)
+	{
+		std::vector<Entry> scratch;
 		Elf32_Off offset = 0;
 
 		while (offset < m_sectionSize && !m_error)
-			offset = readEntry(offset);
-
-		// Read debug line data.
-		Elf32_Shdr* m_lineHeader;
-		m_lineHeader = m_elf->getSectionHeader(".line");
-		if (m_lineHeader)
-		{
-			char* m_lineSectionDataStart;
-			char* m_lineSectionData;
-			m_lineSectionDataStart = m_elf->getSectionData(m_lineHeader);
-			m_lineSectionData = m_lineSectionDataStart;
-
-			while (m_lineHeader->sh_size > (int)(m_lineSectionData - m_lineSectionDataStart)) {
-				int byteSize;
-				int funcPtr;
-				char* m_lineSectionDataChunkEnd;
-				m_lineSectionDataChunkEnd = m_lineSectionData;
-
-				byteSize = read<int>(m_lineSectionData);
-				m_lineSectionData += sizeof(int);
-				m_lineSectionDataChunkEnd += byteSize;
-
-				funcPtr = read<int>(m_lineSectionData);
-				m_lineSectionData += sizeof(int);
-
-				while (m_lineSectionDataChunkEnd > m_lineSectionData) {
-					LineEntry entry;
-
-					entry.lineNumber = read<int>(m_lineSectionData);
-					m_lineSectionData += sizeof(int);
-					entry.charOffset = read<short>(m_lineSectionData);
-					m_lineSectionData += sizeof(short);
-					entry.hexAddressOffset = read<int>(m_lineSectionData);
-					m_lineSectionData += sizeof(int);
-					lineEntryMap.insert(std::pair<int, LineEntry>(funcPtr, entry));
-					if (entry.lineNumber == 0)
-						break; // End.
+		{
+			scratch.clear();
+
+			Elf32_Off next = readEntry(offset, scratch, &m_error);
+
+			if (m_error)
+				break;
+
+			Entry &entry = scratch.back();
+			Attribute *siblingAttr = entry.get(DW_AT_sibling);
+
+			if (siblingAttr)
+			{
+				Elf32_Off sibling = siblingAttr->getReference();
+
+				if (sibling > next && sibling <= m_sectionSize)
+					next = sibling;
+			}
+
+			Unit unit;
+			unit.begin = offset;
+			unit.end = next;
+			unit.skipped = false;
+
+			if (unitFilter && (entry.tag == DW_TAG_compile_unit || entry.tag == DW_TAG_MW_overlay_branch))
+			{
+				Attribute *nameAttr = entry.get(DW_AT_name);
+				unit.skipped = !unitFilter(nameAttr ? nameAttr->getString() : "");
+			}
+
+			units.push_back(unit);
+
+			offset = next;
+		}
+	}
+
+	// Splits the units into at most numThreads contiguous ranges of roughly
+	// equal byte size. Returns the index of the first unit of every range,
+	// followed by units.size().
+	std::vector<size_t> splitUnits(unsigned numThreads) const
+	{
+		// Don't bother splitting off jobs smaller than this
+		const Elf32_Word minJobSize = 256 * 1024;
+
+		if (numThreads == 0)
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		size_t numJobs = std::min<size_t>(numThreads, m_sectionSize / minJobSize);
+		numJobs = std::max<size_t>(1, std::min(numJobs, units.size()));
+
+		std::vector<size_t> bounds(1, 0);
+		size_t unit = 0;
+
+		for (size_t i = 0; i < numJobs; i++)
+		{
+			Elf32_Off target = (Elf32_Off)((uint64_t)m_sectionSize * (i + 1) / numJobs);
+			size_t firstUnit = unit;
+
+			while (unit < units.size() && (units[unit].begin < target || unit == firstUnit || i == numJobs - 1))
+				unit++;
+
+			bounds.push_back(unit);
+		}
+
+		return bounds;
+	}
+
+	// Checks everything the decoder will read, without decoding it: entry
+	// lengths, attribute forms, block sizes, string termination and sibling
+	// targets. If all of it is sound, the units are decoded without bounds
+	// checks; otherwise every read is checked and the problems are described
+	// in `diagnostics`.
+	void validateUnits(unsigned numThreads)
+	{
+		// Problems described per job; validation goes on to count the rest
+		const size_t maxDiagnostics = 16;
+
+		struct Job
+		{
+			std::vector<Diagnostic> diagnostics;
+			size_t numProblems = 0;
+		};
+
+		std::vector<size_t> bounds = splitUnits(numThreads);
+		std::vector<Job> jobs(bounds.size() - 1);
+
+		runParallel(jobs.size(), [this, &bounds, &jobs, maxDiagnostics](size_t i) {
+			Job &job = jobs[i];
+
+			auto report = [&job, maxDiagnostics](Elf32_Off offset, std::string message) {
+				if (job.diagnostics.size() < maxDiagnostics)
+					job.diagnostics.push_back({ offset, std::move(message) });
+
+				job.numProblems++;
+			};
+
+			std::vector<Elf32_Off> entryOffsets;
+			std::vector<std::pair<Elf32_Off, Elf32_Off>> siblings; // Entry offset, target
+
+			for (size_t u = bounds[i]; u < bounds[i + 1]; u++)
+			{
+				const Unit &unit = units[u];
+				Elf32_Off offset = unit.begin;
+
+				entryOffsets.clear();
+				siblings.clear();
+
+				// Entries past a broken one can't be found, so siblings pointing
+				// there aren't checked
+				Elf32_Off walked = unit.end;
+
+				while (offset < unit.end)
+				{
+					entryOffsets.push_back(offset);
+
+					Elf32_Off next = validateEntry(offset, &siblings, report);
+
+					if (next == 0)
+						walked = offset;
+
+					if (next == 0 || unit.skipped)
+						break;
+
+					offset = next;
+				}
+
+				// A sibling must be a later entry of the same unit, or the end of the unit
+				for (auto &sibling : siblings)
+				{
+					Elf32_Off target = sibling.second;
+
+					if (target <= sibling.first)
+						report(sibling.first, "DW_AT_sibling " + toHex(target) + " doesn't point forward");
+					else if (target > unit.end)
+						report(sibling.first, "DW_AT_sibling " + toHex(target) + " points past the end of its unit at " + toHex(unit.end));
+					else if (target < walked && !unit.skipped && !std::binary_search(entryOffsets.begin(), entryOffsets.end(), target))
+						report(sibling.first, "DW_AT_sibling " + toHex(target) + " doesn't point at an entry");
+				}
+			}
+		});
+
+		for (Job &job : jobs)
+		{
+			diagnostics.insert(diagnostics.end(), job.diagnostics.begin(), job.diagnostics.end());
+			numProblems += job.numProblems;
+		}
+
+		m_checked = numProblems > 0;
+	}
+
+	// Checks the entry at `offset` and its attributes. Sibling references are
+	// added to `siblings` to be checked once all entries of the unit are known.
+	// Returns the offset of the next entry, or 0 if the rest of the unit can't
+	// be found.
+	template<class Report>
+	Elf32_Off validateEntry(Elf32_Off offset, std::vector<std::pair<Elf32_Off, Elf32_Off>> *siblings, Report &report) const
+	{
+		if (m_sectionSize - offset < sizeof(Elf32_Word))
+		{
+			report(offset, "entry length runs past the end of the section");
+			return 0;
+		}
+
+		Elf32_Word length = read<Elf32_Word>(m_sectionData + offset);
+
+		if (length == 0)
+		{
+			report(offset, "entry has length 0");
+			return 0;
+		}
+
+		if (length > m_sectionSize - offset)
+		{
+			report(offset, "entry length " + toHex(length) + " runs past the end of the section");
+			return 0;
+		}
+
+		Elf32_Off end = offset + length;
+
+		// Shorter entries hold no tag, and are null entries like in readEntry
+		if (length < 8)
+			return end;
+
+		Elf32_Off entryOffset = offset;
+		offset += sizeof(Elf32_Word) + sizeof(Elf32_Half);
+
+		while (offset < end)
+		{
+			Elf32_Off attrOffset = offset;
+
+			if (end - offset < sizeof(Elf32_Half))
+			{
+				report(attrOffset, "attribute name runs past the end of its entry");
+				return 0;
+			}
+
+			Elf32_Half name = read<Elf32_Half>(m_sectionData + offset);
+			offset += sizeof(Elf32_Half);
+
+			Elf32_Word size;
+
+			switch (name & 0xf)
+			{
+			case DW_FORM_ADDR:
+			case DW_FORM_REF:
+			case DW_FORM_DATA4:
+				size = sizeof(Elf32_Word);
+				break;
+			case DW_FORM_DATA2:
+				size = sizeof(Elf32_Half);
+				break;
+			case DW_FORM_DATA8:
+				size = sizeof(uint64_t);
+				break;
+			case DW_FORM_BLOCK2:
+				if (end - offset < sizeof(Elf32_Half))
+				{
+					report(attrOffset, "block size of attribute " + toHex(name) + " runs past the end of its entry");
+					return 0;
 				}
+
+				size = read<Elf32_Half>(m_sectionData + offset);
+				offset += sizeof(Elf32_Half);
+				break;
+			case DW_FORM_BLOCK4:
+				if (end - offset < sizeof(Elf32_Word))
+				{
+					report(attrOffset, "block size of attribute " + toHex(name) + " runs past the end of its entry");
+					return 0;
+				}
+
+				size = read<Elf32_Word>(m_sectionData + offset);
+				offset += sizeof(Elf32_Word);
+				break;
+			case DW_FORM_STRING:
+			{
+				const char *str = m_sectionData + offset;
+				const char *terminator = (const char*)memchr(str, '\0', end - offset);
+
+				if (!terminator)
+				{
+					report(attrOffset, "string of attribute " + toHex(name) + " isn't terminated within its entry");
+					return 0;
+				}
+
+				size = (Elf32_Word)(terminator - str) + 1;
+				break;
+			}
+			default:
+				report(attrOffset, "attribute " + toHex(name) + " has unknown form " + toHex(name & 0xf));
+				return 0;
 			}
+
+			if (size > end - offset)
+			{
+				report(attrOffset, "attribute " + toHex(name) + " of size " + toHex(size) + " runs past the end of its entry");
+				return 0;
+			}
+
+			if (name == DW_AT_sibling)
+				siblings->emplace_back(entryOffset, read<Elf32_Off>(m_sectionData + offset));
+
+			offset += size;
 		}
+
+		return end;
 	}
 
-	Elf32_Off readEntry(Elf32_Off offset, int *outIndex = nullptr)
+	// Second phase: decode the units on separate threads, each into its own
+	// buffer, then stitch the buffers into `entries` and rebase the indices.
+	void readUnits(unsigned numThreads)
 	{
+		struct Job
+		{
+			size_t firstUnit;
+			size_t lastUnit;
+			size_t base;
+			std::vector<Entry> entries;
+			Error error;
+		};
+
+		std::vector<size_t> bounds = splitUnits(numThreads);
+		std::vector<Job> jobs(bounds.size() - 1);
+
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			jobs[i].firstUnit = bounds[i];
+			jobs[i].lastUnit = bounds[i + 1];
+			jobs[i].error = ERR_NONE;
+		}
+
+		size_t numJobs = jobs.size();
+
+		runParallel(numJobs, [this, &jobs](size_t i) {
+			Job &job = jobs[i];
+
+			if (m_checked)
+				readUnitRange<true>(job.firstUnit, job.lastUnit, job.entries, &job.error);
+			else
+				readUnitRange<false>(job.firstUnit, job.lastUnit, job.entries, &job.error);
+		});
+
+		size_t total = 0;
+
+		for (Job &job : jobs)
+		{
+			if (job.error)
+			{
+				m_error = job.error;
+				return;
+			}
+
+			job.base = total;
+			total += job.entries.size();
+		}
+
+		entries.resize(total);
+
+		runParallel(numJobs, [this, &jobs](size_t i) {
+			Job &job = jobs[i];
+
+			for (size_t e = 0; e < job.entries.size(); e++)
+			{
+				Entry &entry = entries[job.base + e];
+
+				entry = std::move(job.entries[e]);
+				entry.index += (int)job.base;
+
+				for (Attribute &attr : entry.attributes)
+					attr.entryIndex = entry.index;
+			}
+		});
+	}
+
+	template<bool checked>
+	void readUnitRange(size_t firstUnit, size_t lastUnit, std::vector<Entry> &out, Error *error)
+	{
+		for (size_t u = firstUnit; u < lastUnit && !*error; u++)
+		{
+			Elf32_Off offset = units[u].begin;
+
+			if (units[u].skipped)
+			{
+				readEntry<checked>(offset, out, error);
+				continue;
+			}
+
+			while (offset < units[u].end && !*error)
+				offset = readEntry<checked>(offset, out, error);
+		}
+	}
+
+	// Runs fn(0) .. fn(count - 1), each on its own thread
+	template<class Fn>
+	static void runParallel(size_t count, Fn fn)
+	{
+		std::vector<std::thread> threads;
+
+		for (size_t i = 1; i < count; i++)
+			threads.emplace_back(fn, i);
+
+		if (count > 0)
+			fn(0);
+
+		for (std::thread &t : threads)
+			t.join();
+	}
+
+	// Decodes the entry at `offset` and appends it to `out`. Entry indices are
+	// relative to `out`. Returns the offset of the next entry. Unless `checked`,
+	// the entry must have passed validateEntry.
+	template<bool checked = true>
+	Elf32_Off readEntry(Elf32_Off offset, std::vector<Entry> &out, Error *error)
+	{
+		if (checked && (offset > m_sectionSize || m_sectionSize - offset < sizeof(Elf32_Word)))
+		{
+			*error = ERR_INVALID_ENTRY;
+			return 0;
+		}
+
 		Entry entry;
 
 		entry.dwarf = this;
-		entry.index = entries.size();
+		entry.index = out.size();
 		entry.offset = offset;
 		entry.length = read<Elf32_Word>(m_sectionData + offset);
-
-		m_entryIndexRefMap[offset] = entry.index;
+		entry.tag = DW_TAG_padding;
 
 		Elf32_Word end = offset + entry.length;
 
+		if (entry.length == 0)
+		{
+			*error = ERR_INVALID_ENTRY;
+			return 0;
+		}
+
 		if (entry.isNullEntry()) // Null entry
 			offset = end;
 		else
 		{
 			offset += sizeof(Elf32_Word);
 
+			if (checked && m_sectionSize - offset < sizeof(Elf32_Half))
+			{
+				*error = ERR_INVALID_ENTRY;
+				return 0;
+			}
+
 			entry.tag = read<Elf32_Half>(m_sectionData + offset);
 			offset += sizeof(Elf32_Half);
 
-			while (offset < end && !m_error)
-				offset = readAttribute(offset, &entry);
+			while (offset < end && !*error)
+				offset = readAttribute<checked>(offset, &entry, error);
 
 			if (offset > end)
 			{
-				m_error = ERR_INVALID_ENTRY;
+				*error = ERR_INVALID_ENTRY;
 				return 0;
 			}
 		}
 
-		entries.push_back(entry);
-
-		if (outIndex)
-			*outIndex = entry.index;
+		out.push_back(std::move(entry));
 
 		return offset;
 	}
 
-	Elf32_Off readAttribute(Elf32_Off offset, Entry *entry, int *outIndex = nullptr)
+	// Decodes the attribute at `offset` into `out` and returns the offset just
+	// past it. Only reads the section: nothing is stored or allocated, so it
+	// can decode attributes embedded in blocks at any time. `out->entryIndex`
+	// is left for the caller. Returns 0 and sets `error` on an unknown form or
+	// an attribute running past the end of the section. Unless `checked`, the
+	// attribute must have passed validateEntry.
+	template<bool checked = true>
+	Elf32_Off decodeAttribute(Elf32_Off offset, Attribute *out, Error *error) const
 	{
-		Attribute attribute;
+		if (checked && offset + sizeof(Elf32_Half) > m_sectionSize)
+		{
+			*error = ERR_INVALID_ATTRIBUTE;
+			return 0;
+		}
 
-		attribute.dwarf = entry->dwarf;
-		attribute.entryIndex = entry->index;
-		attribute.offset = offset;
-		attribute.name = read<Elf32_Half>(m_sectionData + offset);
+		out->dwarf = const_cast<Dwarf*>(this);
+		out->offset = offset;
+		out->name = read<Elf32_Half>(m_sectionData + offset);
 		offset += sizeof(Elf32_Half);
 
-		Elf32_Half form = attribute.getForm();
-
-		switch (form)
+		switch (out->getForm())
 		{
 		case DW_FORM_ADDR:
-			attribute.size = sizeof(Elf32_Addr);
+			out->size = sizeof(Elf32_Addr);
 			break;
 		case DW_FORM_REF:
-			attribute.size = sizeof(Elf32_Off);
+			out->size = sizeof(Elf32_Off);
 			break;
 		case DW_FORM_BLOCK2:
-			attribute.size = read<Elf32_Half>(m_sectionData + offset);
+			out->size = read<Elf32_Half>(m_sectionData + offset);
 			offset += sizeof(Elf32_Half);
 			break;
 		case DW_FORM_BLOCK4:
-			attribute.size = read<Elf32_Word>(m_sectionData + offset);
+			out->size = read<Elf32_Word>(m_sectionData + offset);
 			offset += sizeof(Elf32_Word);
 			break;
 		case DW_FORM_DATA2:
-			attribute.size = sizeof(Elf32_Half);
+			out->size = sizeof(Elf32_Half);
 			break;
 		case DW_FORM_DATA4:
-			attribute.size = sizeof(Elf32_Word);
+			out->size = sizeof(Elf32_Word);
 			break;
 		case DW_FORM_DATA8:
-			attribute.size = sizeof(uint64_t);
+			out->size = sizeof(uint64_t);
 			break;
 		case DW_FORM_STRING:
-			attribute.size = strlen(m_sectionData + offset) + 1;
+			if (checked)
+				out->size = strnlen(m_sectionData + offset, m_sectionSize - offset) + 1;
+			else
+				out->size = strlen(m_sectionData + offset) + 1;
 			break;
 		default:
-			m_error = ERR_INVALID_ATTRIBUTE;
+			*error = ERR_INVALID_ATTRIBUTE;
+			return 0;
+		}
+
+		if (checked && (offset > m_sectionSize || out->size > m_sectionSize - offset))
+		{
+			*error = ERR_INVALID_ATTRIBUTE;
 			return 0;
 		}
 
-		attribute.value = m_sectionData + offset;
+		out->value = m_sectionData + offset;
 
-		int index = entry->attributes.size();
+		return offset + out->size;
+	}
+
+	// Decodes the attribute at `offset` and appends it to the entry
+	template<bool checked>
+	Elf32_Off readAttribute(Elf32_Off offset, Entry *entry, Error *error)
+	{
+		Attribute attribute;
+
+		offset = decodeAttribute<checked>(offset, &attribute, error);
 
+		if (*error)
+			return 0;
+
+		attribute.dwarf = entry->dwarf;
+		attribute.entryIndex = entry->index;
 		entry->attributes.push_back(attribute);
-		
-		if (outIndex)
-			*outIndex = index;
+		entry->indexAttribute(entry->attributes.size() - 1);
+
+		return offset;
+	}
+
+	// Reads the .line section. Every chunk is a byte size and the function's
+	// address followed by fixed-size records, ending with a record whose line
+	// number is 0. The records of a chunk are decoded in one bulk call and the
+	// chunk is cut after the end record.
+	void readLineTable()
+	{
+		const Elf32_Shdr *lineHeader = m_elf->getSectionHeader(".line");
+
+		if (!lineHeader)
+			return;
+
+		const unsigned char *start = (const unsigned char*)m_elf->getSectionData(lineHeader);
+		size_t sectionSize = lineHeader->sh_size;
+		size_t pos = 0;
+		bool swap = m_elf->shouldReverseEndian();
+
+		const size_t headerSize = sizeof(int) * 2;
 
-		return offset + attribute.size;
+		while (pos + headerSize <= sectionSize)
+		{
+			LineTable::Chunk chunk;
+
+			Elf32_Word byteSize = BulkDecode::load32(start + pos, swap);
+			chunk.address = BulkDecode::load32(start + pos + sizeof(int), swap);
+
+			size_t recordsStart = pos + headerSize;
+			size_t chunkEnd = pos + byteSize;
+
+			// A partial trailing record still counts, but never read past the section
+			size_t count = 0;
+			if (chunkEnd > recordsStart)
+				count = (chunkEnd - recordsStart + BulkDecode::LINE_RECORD_SIZE - 1) / BulkDecode::LINE_RECORD_SIZE;
+
+			size_t maxCount = (sectionSize - recordsStart) / BulkDecode::LINE_RECORD_SIZE;
+			if (count > maxCount)
+				count = maxCount;
+
+			chunk.begin = m_lineTable.lineNumber.size();
+
+			m_lineTable.lineNumber.resize(chunk.begin + count);
+			m_lineTable.charOffset.resize(chunk.begin + count);
+			m_lineTable.addressOffset.resize(chunk.begin + count);
+
+			BulkDecode::LineColumns columns;
+			columns.lineNumber = m_lineTable.lineNumber.data() + chunk.begin;
+			columns.charOffset = m_lineTable.charOffset.data() + chunk.begin;
+			columns.addressOffset = m_lineTable.addressOffset.data() + chunk.begin;
+
+			BulkDecode::decodeLineRecords(start + recordsStart, count, sectionSize - recordsStart, swap, columns);
+
+			// Stop after the end record; anything following it starts the next chunk
+			size_t used = count;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (columns.lineNumber[i] == 0)
+				{
+					used = i + 1;
+					break;
+				}
+			}
+
+			chunk.end = chunk.begin + used;
+
+			m_lineTable.lineNumber.resize(chunk.end);
+			m_lineTable.charOffset.resize(chunk.end);
+			m_lineTable.addressOffset.resize(chunk.end);
+			m_lineTable.chunks.push_back(chunk);
+
+			if (used == 0)
+				pos = recordsStart;
+			else
+				pos = recordsStart + used * BulkDecode::LINE_RECORD_SIZE;
+		}
+
+		std::stable_sort(m_lineTable.chunks.begin(), m_lineTable.chunks.end(), LineTable::ChunkLess());
 	}
 
 	inline Error getError()
@@ -531,37 +1177,73 @@ public:
 		return m_error;
 	}
 
+	// Whether validation found problems, so the entries were decoded with every read checked
+	inline bool isChecked() const
+	{
+		return m_checked;
+	}
+
+	// Entries are stored in section order, so a reference is found by binary search on the offset
 	inline Entry* getEntryFromReference(Elf32_Off ref)
 	{
-		if (m_entryIndexRefMap.count(ref) == 0)
+		auto it = std::lower_bound(entries.begin(), entries.end(), ref,
+			[](const Entry &e, Elf32_Off offset) { return e.offset < offset; });
+
+		if (it == entries.end() || it->offset != ref)
 			return nullptr;
 
-		return &entries[m_entryIndexRefMap[ref]];
+		return &*it;
+	}
+
+	// The index of the unit holding an offset, or units.size()
+	inline size_t findUnit(Elf32_Off offset) const
+	{
+		auto it = std::upper_bound(units.begin(), units.end(), offset,
+			[](Elf32_Off o, const Unit &unit) { return o < unit.begin; });
+
+		if (it == units.begin() || offset >= (it - 1)->end)
+			return units.size();
+
+		return (it - 1) - units.begin();
 	}
 
-	inline Elf32_Off pointerToOffset(char *ptr)
+	inline Elf32_Off pointerToOffset(const char *ptr)
 	{
 		return ptr - m_sectionData;
 	}
 
-	inline char* offsetToPointer(Elf32_Off offset)
+	inline const char* offsetToPointer(Elf32_Off offset)
 	{
 		return m_sectionData + offset;
 	}
 
+	// Lets the OS drop the section bytes of the decoded units from memory
+	inline void discardUnits() const
+	{
+		for (const Unit &unit : units)
+			m_elf->discard(m_sectionData + unit.begin, unit.end - unit.begin);
+	}
+
 	template<class T>
-	inline T read(void *data)
+	inline T read(const void *data) const
 	{
 		return m_elf->read<T>(data);
 	}
 
+	static std::string toHex(Elf32_Off value)
+	{
+		char buffer[16];
+		snprintf(buffer, sizeof(buffer), "0x%x", value);
+		return buffer;
+	}
+
 private:
 	Error m_error;
+	bool m_checked = true; // Until validateUnits finds the section sound
 
 	ElfFile *m_elf;
-	Elf32_Shdr *m_section;
-	char *m_sectionData;
+	LineTable m_lineTable; // Empty in unit views
+	const Elf32_Shdr *m_section;
+	const char *m_sectionData;
 	Elf32_Word m_sectionSize;
-
-	std::unordered_map<Elf32_Off, int> m_entryIndexRefMap;
 };
@@ -0,0 +1,517 @@
+#include "dwarf2cpp.h"
+#include "work_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+Dwarf2Cpp::Dwarf2Cpp(const Converter::Options &options)
+	: m_options(options)
+{
+	m_log = nullptr;
+	m_privateCopy = false;
+	m_converter.reset(new Converter(m_options, &m_symbolTable));
+}
+
+Dwarf2Cpp::~Dwarf2Cpp()
+{
+	release();
+}
+
+bool Dwarf2Cpp::fail(Error::Kind kind, int code, std::string message)
+{
+	m_errors.push_back(Error{ kind, code, 0, std::move(message) });
+	return false;
+}
+
+// Loads the ELF file, its symbol table and the units of its DWARF data, and
+// decodes their entries if `decodeEntries` is set
+bool Dwarf2Cpp::open(const std::string &elfFilename, unsigned numThreads, bool decodeEntries)
+{
+	release();
+	m_errors.clear();
+
+	if (m_log)
+		*m_log << "Loading ELF file " << elfFilename << "..." << std::endl;
+
+	m_elf.reset(new ElfFile(elfFilename.c_str(), m_privateCopy));
+
+	if (m_elf->getError())
+		return fail(Error::ELF, m_elf->getError(), "Failed to parse " + elfFilename + " as an ELF file. Error Code: " + std::to_string(m_elf->getError()));
+
+	// Names and addresses DWARF doesn't have
+	if (m_log)
+		*m_log << "Loading symbol table..." << std::endl;
+
+	if (!m_symbolTable.loadFromElf(m_elf.get(), m_log) && m_log)
+		*m_log << "Warning: Could not load symbol table. Output may have missing names." << std::endl;
+
+	if (m_log)
+		*m_log << "Loading DWARFv1 information..." << std::endl;
+
+	Dwarf::UnitFilter unitFilter;
+
+	if (!m_options.filter.compileUnits.empty())
+		unitFilter = [this](const char *name) { return m_options.filter.matchCompileUnit(name); };
+
+	m_dwarf.reset(new Dwarf(m_elf.get(), numThreads, unitFilter, decodeEntries));
+
+	if (m_dwarf->getError())
+		return fail(Error::DWARF, m_dwarf->getError(), "Failed to parse DWARF data. Error Code: " + std::to_string(m_dwarf->getError()));
+
+	return true;
+}
+
+// Moves the converter's errors to the context's, returning `success`
+bool Dwarf2Cpp::takeConversionErrors(bool success)
+{
+	for (Converter::Error &error : m_converter->errors)
+		m_errors.push_back(Error{ Error::CONVERSION, 0, error.offset, std::move(error.message) });
+
+	m_converter->errors.clear();
+
+	if (!success)
+		return fail(Error::CONVERSION, 0, "Failed to process DWARF data.");
+
+	return true;
+}
+
+bool Dwarf2Cpp::load(const std::string &elfFilename, unsigned numThreads)
+{
+	if (!open(elfFilename, numThreads, true))
+		return false;
+
+	if (m_log)
+		*m_log << "Converting DWARFv1 entries to C++ data..." << std::endl;
+
+	if (!takeConversionErrors(m_converter->convert(m_dwarf.get())))
+		return false;
+
+	m_converter->trimCaches();
+
+	for (Cpp::File *cpp : m_converter->files)
+		m_converter->selectReachableTypes(cpp);
+
+	if (m_log)
+	{
+		*m_log << "Done converting DWARFv1 data!" << std::endl;
+		*m_log << "\tNumber of C++ files: " << m_converter->files.size() << std::endl << std::endl;
+	}
+
+	return true;
+}
+
+void Dwarf2Cpp::release()
+{
+	m_index.reset();
+	m_converter.reset(new Converter(m_options, &m_symbolTable));
+	m_dwarf.reset();
+	m_symbolTable = SymbolTable();
+	m_elf.reset();
+}
+
+const ModelIndex& Dwarf2Cpp::getIndex()
+{
+	if (!m_index)
+		m_index.reset(new ModelIndex(m_converter->files, m_dwarf.get(), &m_symbolTable));
+
+	return *m_index;
+}
+
+// Finds out how long the model of each unit has to be kept in streaming
+// mode: keepUntil[u] is the last unit whose conversion can still change what
+// unit u writes, or that reads u's model. Units are grouped with the units of
+// the types they refer to, the units adding static member functions to their
+// classes, and later units with the same file name, which are merged into the
+// same file; a group is kept until its last unit is converted. Each unit is
+// decoded on its own and dropped again right away; only the type names seen
+// so far are remembered. Skipped units join the groups of the units that
+// refer to their types, since the converter decodes them for those.
+bool Dwarf2Cpp::planStreaming(std::vector<size_t> &keepUntil)
+{
+	Dwarf *dwarf = m_dwarf.get();
+	size_t numUnits = dwarf->units.size();
+
+	std::unordered_map<std::string, size_t> typeUnits; // Class name as written -> last unit with it
+	std::unordered_map<std::string_view, size_t> fileUnits; // File name -> first unit with it
+	std::vector<size_t> groups(numUnits); // Another unit of the same group, or the unit itself
+
+	for (size_t u = 0; u < numUnits; u++)
+		groups[u] = u;
+
+	auto findGroup = [&](size_t u) {
+		while (groups[u] != u)
+			u = groups[u] = groups[groups[u]];
+
+		return u;
+	};
+
+	// The group keeps the number of its last unit
+	auto join = [&](size_t a, size_t b) {
+		a = findGroup(a);
+		b = findGroup(b);
+
+		if (a < b)
+			groups[a] = b;
+		else
+			groups[b] = a;
+	};
+
+	// Skipped units are only decoded if others refer to their types, which
+	// the converter does as well
+	std::vector<bool> scanned(numUnits, false);
+	std::vector<size_t> referencedSkipped;
+
+	auto joinReferences = [&](Dwarf &view, size_t u) {
+		scanned[u] = true;
+
+		for (Dwarf::Entry &entry : view.entries)
+		{
+			for (Dwarf::Attribute &attr : entry.attributes)
+			{
+				Elf32_Off ref;
+
+				if (!Converter::getTypeReference(&attr, &ref))
+					continue;
+
+				size_t target = dwarf->findUnit(ref);
+
+				if (target == numUnits)
+					continue;
+
+				join(u, target);
+
+				if (dwarf->units[target].skipped && !scanned[target])
+				{
+					scanned[target] = true;
+					referencedSkipped.push_back(target);
+				}
+			}
+		}
+	};
+
+	for (size_t u = 0; u < numUnits; u++)
+	{
+		if (dwarf->units[u].skipped)
+			continue;
+
+		Dwarf view(*dwarf, u);
+
+		if (view.getError())
+			return fail(Error::DWARF, view.getError(), "Failed to decode compile unit " + std::to_string(u) + ". Error Code: " + std::to_string(view.getError()));
+
+		Dwarf::Entry *unitEntry = &view.entries.front();
+
+		if (unitEntry->tag != DW_TAG_compile_unit && unitEntry->tag != DW_TAG_MW_overlay_branch)
+			continue;
+
+		Dwarf::Attribute *nameAttr = unitEntry->get(DW_AT_name);
+
+		if (nameAttr)
+		{
+			auto first = fileUnits.emplace(nameAttr->getString(), u).first;
+			join(first->second, u);
+		}
+
+		joinReferences(view, u);
+
+		// Names as assignNameSuffixes() will number them
+		std::vector<std::pair<std::string, int>> typeNames;
+		std::unordered_map<std::string, int> typeNameCounts;
+		std::vector<std::string> staticClassNames;
+		std::string className;
+
+		for (Dwarf::Entry *entry = unitEntry + 1; entry; entry = entry->getSibling())
+		{
+			switch (entry->tag)
+			{
+			case DW_TAG_class_type:
+			case DW_TAG_structure_type:
+			case DW_TAG_enumeration_type:
+			case DW_TAG_array_type:
+			case DW_TAG_subroutine_type:
+			case DW_TAG_union_type:
+			{
+				Dwarf::Attribute *typeName = entry->get(DW_AT_name);
+				std::string name = Cpp::SanitizeName(typeName ? typeName->getString() : "");
+				int index = typeNameCounts[name]++;
+
+				// Only classes own member functions
+				if (entry->tag == DW_TAG_class_type || entry->tag == DW_TAG_structure_type || entry->tag == DW_TAG_union_type)
+					typeNames.emplace_back(name, index);
+
+				break;
+			}
+			case DW_TAG_global_subroutine:
+			case DW_TAG_subroutine:
+			case DW_TAG_inlined_subroutine:
+			{
+				Dwarf::Attribute *mangledName = entry->get(DW_AT_mangled_name);
+
+				if (!mangledName || !m_converter->matchFunctionEntry(entry) || !m_converter->getMangledClassName(mangledName->getString(), &className))
+					break;
+
+				// Functions with a "this" parameter belong to its type instead
+				Dwarf::Entry *next = entry->getSibling();
+				Dwarf::Entry *child = entry + 1;
+
+				while (child && child < next && child->tag != DW_TAG_formal_parameter)
+					child = child->getSibling();
+
+				if (child && child < next)
+				{
+					Dwarf::Attribute *paramName = child->get(DW_AT_name);
+
+					if (paramName && strcmp(paramName->getString(), "this") == 0)
+						break;
+				}
+
+				staticClassNames.push_back(className);
+				break;
+			}
+			}
+		}
+
+		for (auto &typeName : typeNames)
+		{
+			std::string name = typeName.first.empty() ? "type" : typeName.first;
+
+			if (typeNameCounts[typeName.first] > 1)
+				name += "_" + std::to_string(typeName.second);
+
+			typeUnits[name] = u;
+		}
+
+		// Like Converter::assignStaticMethods(), after the unit's own classes
+		for (const std::string &name : staticClassNames)
+		{
+			auto owner = typeUnits.find(name);
+
+			if (owner != typeUnits.end())
+				join(owner->second, u);
+		}
+	}
+
+	while (!referencedSkipped.empty())
+	{
+		size_t u = referencedSkipped.back();
+		referencedSkipped.pop_back();
+
+		Dwarf view(*dwarf, u);
+
+		if (view.getError())
+			return fail(Error::DWARF, view.getError(), "Failed to decode compile unit " + std::to_string(u) + ". Error Code: " + std::to_string(view.getError()));
+
+		joinReferences(view, u);
+	}
+
+	keepUntil.resize(numUnits);
+
+	for (size_t u = 0; u < numUnits; u++)
+		keepUntil[u] = findGroup(u);
+
+	return true;
+}
+
+// The model of one unit in streaming mode
+struct StreamUnit
+{
+	Dwarf *dwarf = nullptr;
+	std::vector<Cpp::File*> files; // Files first created by this unit
+};
+
+// `range` is the unit in the whole section. Skipped units have no view, but
+// the converter may have decoded them for their types.
+static void releaseStreamUnit(StreamUnit *unit, const Dwarf::Unit &range, Converter &converter)
+{
+	for (Cpp::File *cpp : unit->files)
+	{
+		converter.files.erase(std::find(converter.files.begin(), converter.files.end(), cpp));
+		delete cpp;
+	}
+
+	converter.releaseTypes(range.begin, range.end);
+
+	if (unit->dwarf)
+	{
+		unit->dwarf->discardUnits();
+		delete unit->dwarf;
+	}
+
+	unit->files.clear();
+	unit->dwarf = nullptr;
+}
+
+// Adds the problems validation found in a unit view to those of the section
+static void addDiagnostics(Dwarf *section, const Dwarf *view)
+{
+	const size_t maxDiagnostics = 16;
+
+	for (const Dwarf::Diagnostic &diagnostic : view->diagnostics)
+	{
+		if (section->diagnostics.size() < maxDiagnostics)
+			section->diagnostics.push_back(diagnostic);
+	}
+
+	section->numProblems += view->numProblems;
+}
+
+bool Dwarf2Cpp::stream(const std::string &elfFilename, const FileHandler &handler, StreamStats *stats)
+{
+	if (!open(elfFilename, 0, false))
+		return false;
+
+	if (m_log)
+		*m_log << "Planning streaming conversion..." << std::endl;
+
+	std::vector<size_t> keepUntil;
+
+	if (!planStreaming(keepUntil))
+		return false;
+
+	// Units a stage may get ahead of the next one
+	const size_t queueLength = 4;
+
+	Dwarf *dwarf = m_dwarf.get();
+	Converter &converter = *m_converter;
+
+	size_t numUnits = dwarf->units.size();
+	size_t numQueued = 0; // Units before this one have been handed to the writer
+	size_t numFiles = 0;
+	size_t numResident = 0; // Converted units that haven't been released yet
+	size_t maxResident = 0;
+
+	std::vector<StreamUnit> units(numUnits);
+	std::vector<size_t> live; // Queued units that are still needed
+
+	WorkQueue<size_t> decoded(queueLength);
+	WorkQueue<size_t> complete(queueLength);
+	std::atomic<size_t> numWritten(0); // Units before this one have been handed to `handler`
+
+	if (m_log)
+		*m_log << "Converting " << numUnits << " units..." << std::endl;
+
+	// Skipped units are passed on as well, without a view
+	std::thread decoder([&]() {
+		for (size_t u = 0; u < numUnits; u++)
+		{
+			if (!dwarf->units[u].skipped)
+				units[u].dwarf = new Dwarf(*dwarf, u);
+
+			if (!decoded.push(u))
+				break;
+		}
+
+		decoded.close();
+	});
+
+	std::thread writer([&]() {
+		size_t w;
+
+		while (complete.pop(&w))
+		{
+			for (Cpp::File *cpp : units[w].files)
+				handler(cpp);
+
+			numWritten++;
+		}
+	});
+
+	bool success = true;
+	size_t u;
+
+	while (decoded.pop(&u))
+	{
+		StreamUnit &unit = units[u];
+
+		if (unit.dwarf)
+		{
+			size_t firstFile = converter.files.size();
+
+			addDiagnostics(dwarf, unit.dwarf);
+
+			if (unit.dwarf->getError())
+			{
+				success = fail(Error::DWARF, unit.dwarf->getError(), "Failed to parse DWARF data. Error Code: " + std::to_string(unit.dwarf->getError()));
+				break;
+			}
+
+			if (!takeConversionErrors(converter.convert(unit.dwarf)))
+			{
+				success = false;
+				break;
+			}
+
+			unit.files.assign(converter.files.begin() + firstFile, converter.files.end());
+			converter.trimCaches();
+
+			maxResident = std::max(maxResident, ++numResident);
+		}
+
+		while (numQueued <= u && keepUntil[numQueued] <= u)
+		{
+			StreamUnit &next = units[numQueued];
+
+			// The writer reads the unit from now on, so later functions must
+			// not add themselves to its classes anymore. The types it refers
+			// to are all converted now, so its layouts can be computed.
+			if (next.dwarf)
+			{
+				Elf32_Off begin = next.dwarf->units.front().begin;
+				Elf32_Off end = next.dwarf->units.back().end;
+
+				auto first = converter.typesByOffset.lower_bound(begin);
+				auto last = converter.typesByOffset.lower_bound(end);
+
+				for (auto it = first; it != last; ++it)
+					converter.forgetClass(it->second);
+
+				converter.computeLayouts(begin, end);
+			}
+
+			for (Cpp::File *cpp : next.files)
+				converter.selectReachableTypes(cpp);
+
+			numFiles += next.files.size();
+			live.push_back(numQueued);
+			complete.push(numQueued++);
+		}
+
+		// Functions of later units refer to the classes they were added to,
+		// so a unit is released once those units have been written as well
+		size_t written = numWritten;
+
+		auto released = std::remove_if(live.begin(), live.end(), [&](size_t w) {
+			if (keepUntil[w] >= written)
+				return false;
+
+			if (units[w].dwarf)
+				numResident--;
+
+			releaseStreamUnit(&units[w], dwarf->units[w], converter);
+			return true;
+		});
+
+		live.erase(released, live.end());
+	}
+
+	decoded.close();
+	decoder.join();
+
+	complete.close();
+	writer.join();
+
+	// Units still decoded or converted, after a failure or at the end
+	for (size_t w = 0; w < numUnits; w++)
+		releaseStreamUnit(&units[w], dwarf->units[w], converter);
+
+	if (stats)
+	{
+		stats->numFiles = numFiles;
+		stats->maxResidentUnits = maxResident;
+	}
+
+	return success;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "converter.h"
+#include "dwarf.h"
+#include "elf.h"
+#include "model_index.h"
+#include "symbol_table.h"
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The in-process API of libdwarf2cpp. A context loads one ELF file, converts
+// its DWARF data and owns the resulting model until it is released. Contexts
+// share no state, so several of them can load files on different threads.
+//
+//	Dwarf2Cpp context;
+//
+//	if (!context.load("main.elf"))
+//	{
+//		for (const Dwarf2Cpp::Error &error : context.getErrors())
+//			std::cerr << error.message << std::endl;
+//	}
+//
+//	for (Cpp::File *file : context.getFiles())
+//		std::string source = file->toString(false, true);
+//
+// stream() converts a file without keeping all of it in memory, handing each
+// file to a callback as soon as nothing later can change it.
+class Dwarf2Cpp
+{
+public:
+	struct Error
+	{
+		enum Kind
+		{
+			ELF,       // `code` is an ElfFile::Error
+			DWARF,     // `code` is a Dwarf::Error
+			CONVERSION // `offset` is the compile unit that couldn't be converted
+		};
+
+		Kind kind;
+		int code;
+		Elf32_Off offset;
+		std::string message;
+	};
+
+	Dwarf2Cpp(const Converter::Options &options = Converter::Options());
+	~Dwarf2Cpp();
+
+	Dwarf2Cpp(const Dwarf2Cpp&) = delete;
+	Dwarf2Cpp& operator=(const Dwarf2Cpp&) = delete;
+
+	// Progress messages go to `log`, if there is one
+	void setLog(std::ostream *log)
+	{
+		m_log = log;
+	}
+
+	// Makes load() read the ELF file into memory instead of mapping it, for
+	// files that another process may rewrite while they are loaded
+	void setPrivateCopy(bool privateCopy)
+	{
+		m_privateCopy = privateCopy;
+	}
+
+	// Loads and converts an ELF file in place of anything loaded before.
+	// numThreads is passed on to Dwarf. Returns false if the file couldn't be
+	// converted; the errors say why. Some errors don't stop the conversion.
+	bool load(const std::string &elfFilename, unsigned numThreads = 0);
+
+	// Called with each file stream() has converted
+	typedef std::function<void(Cpp::File *file)> FileHandler;
+
+	struct StreamStats
+	{
+		size_t numFiles = 0;
+		size_t maxResidentUnits = 0; // Compile units converted and not released yet, at most
+	};
+
+	// Loads and converts an ELF file like load(), but one compile unit at a
+	// time. A unit is released once no later unit can change its files or
+	// refers to its types, so memory stays close to what the largest group of
+	// related units needs. `handler` gets the files in the order load() would
+	// list them, on a thread of its own while later units are converted; a
+	// file is freed some time after the handler returns. Afterwards getFiles()
+	// is empty, while the ELF file, its symbol table and getDwarf() stay
+	// loaded, with the problems validation found in any unit.
+	bool stream(const std::string &elfFilename, const FileHandler &handler, StreamStats *stats = nullptr);
+
+	// Frees the model and the ELF file
+	void release();
+
+	const std::vector<Cpp::File*>& getFiles() const
+	{
+		return m_converter->files;
+	}
+
+	// Every converted user type by the offset of its entry, including those
+	// no file lists
+	const std::map<Elf32_Off, Cpp::UserType*>& getUserTypes() const
+	{
+		return m_converter->typesByOffset;
+	}
+
+	const std::vector<Error>& getErrors() const
+	{
+		return m_errors;
+	}
+
+	// The decoded entries and validation diagnostics; null before load()
+	Dwarf* getDwarf() const
+	{
+		return m_dwarf.get();
+	}
+
+	ElfFile* getElf() const
+	{
+		return m_elf.get();
+	}
+
+	const SymbolTable& getSymbolTable() const
+	{
+		return m_symbolTable;
+	}
+
+	// Lookups by name and address, built on first use
+	const ModelIndex& getIndex();
+
+private:
+	Converter::Options m_options;
+	std::ostream *m_log;
+	bool m_privateCopy;
+	std::vector<Error> m_errors;
+
+	// Declared in the order they depend on each other, so they are destroyed
+	// in reverse
+	std::unique_ptr<ElfFile> m_elf;
+	SymbolTable m_symbolTable;
+	std::unique_ptr<Dwarf> m_dwarf;
+	std::unique_ptr<Converter> m_converter;
+	std::unique_ptr<ModelIndex> m_index;
+
+	bool fail(Error::Kind kind, int code, std::string message);
+	bool open(const std::string &elfFilename, unsigned numThreads, bool decodeEntries);
+	bool takeConversionErrors(bool success);
+	bool planStreaming(std::vector<size_t> &keepUntil);
+};
@@ -10,6 +10,13 @@
 #include <cstdio>
 #include <cstring>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 typedef uint32_t Elf32_Addr;
 typedef uint16_t Elf32_Half;
 typedef uint32_t Elf32_Off;
@@ -62,6 +69,8 @@ typedef uint32_t Elf32_Word;
 #define SHN_COMMON    0xfff2
 #define SHN_HIRESERVE 0xffff
 
+#define SHT_NOBITS 8
+
 #define swap4(x) (((x >> 24) & 0xff) | ((x << 8) & 0xff0000) |\
 	((x >> 8) & 0xff00) | ((x << 24) & 0xff000000))
 #define swap2(x) (((x << 8) & 0xff00) | ((x >> 8) & 0x00ff))
@@ -134,20 +143,34 @@ public:
 		ERR_FILE_NOT_OPEN,
 		ERR_FILE_EMPTY,
 		ERR_FILE_READ,
-		ERR_INVALID_HEADER
+		ERR_INVALID_HEADER,
+		ERR_TRUNCATED
 	};
 
-	ElfFile(const char *filename)
+	// With privateCopy, the file is read into memory of its own instead of
+	// being mapped. A mapping shows what another process writes to the file
+	// later, and faults once the file is truncated.
+	ElfFile(const char *filename, bool privateCopy = false)
 	{
 		m_error = ERR_NONE;
+		m_file = nullptr;
+		m_fileSize = 0;
+		m_mapped = false;
 
-		loadFile(filename);
-		initEndian();
+		loadFile(filename, privateCopy);
 
 		if (m_error)
 			return;
 
-		Elf32_Ehdr *ehdr = getElfHeader();
+		if (m_fileSize < sizeof(Elf32_Ehdr))
+		{
+			m_error = ERR_TRUNCATED;
+			return;
+		}
+
+		initEndian();
+
+		const Elf32_Ehdr *ehdr = getElfHeader();
 
 		if (ehdr->e_ident[EI_MAG0] != 0x7f ||
 			ehdr->e_ident[EI_MAG1] != 'E' ||
@@ -162,11 +185,31 @@ public:
 		{
 			m_error = ERR_INVALID_HEADER;
 		}
+		else if (!sectionsInFile())
+		{
+			// Likely a file that is still being written
+			m_error = ERR_TRUNCATED;
+		}
 	}
 
-	inline Elf32_Ehdr* getElfHeader() const
+	~ElfFile()
 	{
-		return (Elf32_Ehdr*)m_file;
+#ifndef _WIN32
+		if (m_mapped)
+		{
+			munmap((void*)m_file, m_fileSize);
+			return;
+		}
+#endif
+		delete[] m_file;
+	}
+
+	ElfFile(const ElfFile&) = delete;
+	ElfFile& operator=(const ElfFile&) = delete;
+
+	inline const Elf32_Ehdr* getElfHeader() const
+	{
+		return (const Elf32_Ehdr*)m_file;
 	}
 
 	inline unsigned char getClass() const
@@ -179,22 +222,38 @@ public:
 		return getElfHeader()->e_ident[EI_DATA];
 	}
 
-	inline Elf32_Shdr* getSectionHeader(Elf32_Half index) const
+	inline const Elf32_Shdr* getSectionHeader(Elf32_Half index) const
 	{
-		return (Elf32_Shdr*)(m_file + getElfHeader()->e_shoff) + index;
+		return (const Elf32_Shdr*)(m_file + getElfHeader()->e_shoff) + index;
 	}
 
-	inline char* getSectionName(Elf32_Shdr *shdr) const
+	inline const char* getSectionName(const Elf32_Shdr *shdr) const
 	{
 		return m_file + getSectionHeader(getElfHeader()->e_shstrndx)->sh_offset + shdr->sh_name;
 	}
 
-	inline char* getSectionData(Elf32_Shdr *shdr) const
+	inline const char* getSectionData(const Elf32_Shdr *shdr) const
 	{
 		return m_file + shdr->sh_offset;
 	}
 
-	inline Elf32_Shdr* getSectionHeader(const char *name) const
+	// Drops the pages of a mapped range from the resident set. The data stays
+	// readable and is paged back in from the file if it's touched again.
+	void discard(const void *data, size_t size) const
+	{
+#ifndef _WIN32
+		if (!m_mapped || size == 0)
+			return;
+
+		uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+		uintptr_t begin = (uintptr_t)data & ~(pageSize - 1);
+		uintptr_t end = (uintptr_t)data + size;
+
+		madvise((void*)begin, end - begin, MADV_DONTNEED);
+#endif
+	}
+
+	inline const Elf32_Shdr* getSectionHeader(const char *name) const
 	{
 		for (int i = 0; i < getElfHeader()->e_shnum; i++)
 		{
@@ -210,12 +269,18 @@ public:
 		return m_error;
 	}
 
+	// True when multi-byte values in the file must be byte-swapped to native order
+	inline bool shouldReverseEndian() const
+	{
+		return m_shouldReverseEndian;
+	}
+
 	template<class T>
-	inline T read(void *data) const
+	inline T read(const void *data) const
 	{
-		T x = *(T*)data;
+		T x = *(const T*)data;
 
-		if (m_shouldReverseEndian)
+		if (m_shouldReverseEndian && sizeof(T) > 1)
 		{
 			if (sizeof(T) == 2)
 				x = swap2((uint16_t)x);
@@ -227,9 +292,9 @@ public:
 	}
 
 	// Symbol table access methods
-	inline Elf32_Sym* getSymbolTable(int *count = nullptr) const
+	inline const Elf32_Sym* getSymbolTable(int *count = nullptr) const
 	{
-		Elf32_Shdr *symtab_hdr = getSectionHeader(".symtab");
+		const Elf32_Shdr *symtab_hdr = getSectionHeader(".symtab");
 		if (!symtab_hdr) {
 			if (count) *count = 0;
 			return nullptr;
@@ -239,12 +304,12 @@ public:
 			*count = read<Elf32_Word>(&symtab_hdr->sh_size) / sizeof(Elf32_Sym);
 		}
 		
-		return (Elf32_Sym*)getSectionData(symtab_hdr);
+		return (const Elf32_Sym*)getSectionData(symtab_hdr);
 	}
 	
-	inline char* getStringTable() const
+	inline const char* getStringTable() const
 	{
-		Elf32_Shdr *strtab_hdr = getSectionHeader(".strtab");
+		const Elf32_Shdr *strtab_hdr = getSectionHeader(".strtab");
 		if (!strtab_hdr) return nullptr;
 		
 		return getSectionData(strtab_hdr);
@@ -252,10 +317,10 @@ public:
 	
 	inline const char* getSymbolName(const Elf32_Sym* symbol) const
 	{
-		char* strtab = getStringTable();
+		const char* strtab = getStringTable();
 		if (!strtab || !symbol) return nullptr;
 		
-		Elf32_Word name_offset = read<Elf32_Word>((void*)&symbol->st_name);
+		Elf32_Word name_offset = read<Elf32_Word>(&symbol->st_name);
 		if (name_offset == 0) return nullptr;
 		
 		return strtab + name_offset;
@@ -263,11 +328,49 @@ public:
 
 private:
 	Error m_error;
-	char *m_file;
+	const char *m_file; // Never written to, so one mapping can be shared
+	size_t m_fileSize;
+	bool m_mapped;
 	bool m_shouldReverseEndian;
 
-	void loadFile(const char *filename)
+	void loadFile(const char *filename, bool privateCopy)
 	{
+#ifndef _WIN32
+		// Map the file read-only; the page cache copy is shared with every
+		// other process converting the same file
+		if (!privateCopy)
+		{
+			int fd = open(filename, O_RDONLY);
+
+			if (fd < 0)
+			{
+				m_error = ERR_FILE_NOT_OPEN;
+				return;
+			}
+
+			struct stat st;
+
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+				if (map != MAP_FAILED)
+				{
+					close(fd);
+
+					m_file = (const char*)map;
+					m_fileSize = st.st_size;
+					m_mapped = true;
+					return;
+				}
+			}
+
+			close(fd);
+		}
+#else
+		(void)privateCopy;
+#endif
+
 		FILE *file = fopen(filename, "rb");
 
 		if (!file)
@@ -287,17 +390,51 @@ private:
 			return;
 		}
 
-		m_file = new char[size];
+		char *buffer = new char[size];
 
-		size_t bytesRead = fread(m_file, sizeof(char), size, file);
+		size_t bytesRead = fread(buffer, sizeof(char), size, file);
 		fclose(file);
 
+		m_file = buffer;
+		m_fileSize = size;
+
 		if (bytesRead != size)
 		{
 			m_error = ERR_FILE_READ;
 		}
 	}
 
+	// Whether the section headers and the contents of every section lie
+	// within the file
+	bool sectionsInFile() const
+	{
+		const Elf32_Ehdr *ehdr = getElfHeader();
+		size_t shoff = read<Elf32_Off>(&ehdr->e_shoff);
+		size_t shnum = read<Elf32_Half>(&ehdr->e_shnum);
+
+		if (shoff > m_fileSize || shnum * sizeof(Elf32_Shdr) > m_fileSize - shoff)
+			return false;
+
+		if (shnum > 0 && read<Elf32_Half>(&ehdr->e_shstrndx) >= shnum)
+			return false;
+
+		const Elf32_Shdr *headers = (const Elf32_Shdr*)(m_file + shoff);
+
+		for (size_t i = 0; i < shnum; i++)
+		{
+			size_t offset = read<Elf32_Off>(&headers[i].sh_offset);
+			size_t size = read<Elf32_Word>(&headers[i].sh_size);
+
+			if (read<Elf32_Word>(&headers[i].sh_type) == SHT_NOBITS)
+				continue;
+
+			if (offset > m_fileSize || size > m_fileSize - offset)
+				return false;
+		}
+
+		return true;
+	}
+
 	inline void initEndian()
 	{
 		int x = 1;
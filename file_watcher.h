@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+
+#ifdef __linux__
+	#include <cerrno>
+	#include <poll.h>
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+// Waits for a file to be rewritten, with inotify. The file's directory is
+// watched rather than the file itself, so replacing the file with a rename,
+// as many linkers do, is seen as well. Only available on Linux.
+class FileWatcher
+{
+public:
+	FileWatcher(const std::string &path)
+	{
+		size_t slash = path.rfind('/');
+
+		m_directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+		m_filename = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+#ifdef __linux__
+		m_fd = inotify_init1(IN_CLOEXEC);
+
+		if (m_fd >= 0 && inotify_add_watch(m_fd, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+#endif
+	}
+
+	~FileWatcher()
+	{
+#ifdef __linux__
+		if (m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	bool isAvailable() const
+	{
+#ifdef __linux__
+		return m_fd >= 0;
+#else
+		return false;
+#endif
+	}
+
+	// Blocks until the file has been written and then left alone for
+	// `settleMs` milliseconds, since a build may write it more than once.
+	// Returns false if watching failed.
+	bool waitForChange(int settleMs = 200)
+	{
+#ifdef __linux__
+		if (m_fd < 0)
+			return false;
+
+		bool changed = false;
+
+		while (true)
+		{
+			pollfd pfd = { m_fd, POLLIN, 0 };
+			int ready = poll(&pfd, 1, changed ? settleMs : -1);
+
+			if (ready < 0 && errno == EINTR)
+				continue;
+
+			if (ready < 0)
+				return false;
+
+			if (ready == 0)
+				return true;
+
+			int events = readEvents();
+
+			if (events < 0)
+				return false;
+
+			changed = changed || events > 0;
+		}
+#else
+		(void)settleMs;
+		return false;
+#endif
+	}
+
+private:
+	std::string m_directory;
+	std::string m_filename;
+
+#ifdef __linux__
+	int m_fd;
+
+	// Returns the number of pending events about the file, or -1 on errors
+	int readEvents()
+	{
+		alignas(inotify_event) char buffer[4096];
+		ssize_t size = read(m_fd, buffer, sizeof(buffer));
+
+		if (size < 0)
+			return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+
+		int count = 0;
+
+		for (ssize_t pos = 0; pos < size; )
+		{
+			const inotify_event *event = (const inotify_event*)(buffer + pos);
+
+			// Lost events may have been about the file
+			if ((event->len > 0 && m_filename == event->name) || (event->mask & IN_Q_OVERFLOW))
+				count++;
+
+			pos += sizeof(inotify_event) + event->len;
+		}
+
+		return count;
+	}
+#endif
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Selects which compile units, user types and functions are converted.
+// Patterns are globs where '*' matches any run of characters and '?' any one
+// character. An empty pattern list selects everything in that category.
+class Filter
+{
+public:
+	std::vector<std::string> compileUnits;
+	std::vector<std::string> types;
+	std::vector<std::string> functions;
+
+	// Compile unit paths are matched with '\\' treated as '/'. A pattern
+	// without a '/' is matched against the file name only, so "xEnt.cpp"
+	// selects "C:\\SB\\Core\\x\\xEnt.cpp".
+	bool matchCompileUnit(const char *path) const
+	{
+		if (compileUnits.empty())
+			return true;
+
+		std::string normalized(path);
+
+		for (char &c : normalized)
+		{
+			if (c == '\\')
+				c = '/';
+		}
+
+		size_t slash = normalized.rfind('/');
+		const char *filename = normalized.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+
+		for (const std::string &pattern : compileUnits)
+		{
+			std::string p(pattern);
+
+			for (char &c : p)
+			{
+				if (c == '\\')
+					c = '/';
+			}
+
+			const char *subject = (p.find('/') == std::string::npos) ? filename : normalized.c_str();
+
+			if (matchGlob(p.c_str(), subject))
+				return true;
+		}
+
+		return false;
+	}
+
+	// With type or function patterns given, only the selected categories are
+	// written: "--type z*" alone writes no functions and no variables.
+	bool selectsMembers() const
+	{
+		return !types.empty() || !functions.empty();
+	}
+
+	bool matchType(std::string_view name) const
+	{
+		if (!selectsMembers())
+			return true;
+
+		return matchAny(types, name);
+	}
+
+	// Matches either the plain or the mangled name of a function
+	bool matchFunction(const char *name, const char *mangledName) const
+	{
+		if (!selectsMembers())
+			return true;
+
+		return matchAny(functions, name) || matchAny(functions, mangledName);
+	}
+
+	bool matchVariables() const
+	{
+		return !selectsMembers();
+	}
+
+	bool isEmpty() const
+	{
+		return compileUnits.empty() && !selectsMembers();
+	}
+
+	static bool matchGlob(const char *pattern, std::string_view str)
+	{
+		const char *star = nullptr;
+		size_t pos = 0;
+		size_t retry = 0;
+
+		while (pos < str.size())
+		{
+			if (*pattern == '*')
+			{
+				star = ++pattern;
+				retry = pos;
+			}
+			else if (*pattern != '\0' && (*pattern == '?' || *pattern == str[pos]))
+			{
+				pattern++;
+				pos++;
+			}
+			else if (star)
+			{
+				// Let the last '*' swallow one more character and try again
+				pattern = star;
+				pos = ++retry;
+			}
+			else
+				return false;
+		}
+
+		while (*pattern == '*')
+			pattern++;
+
+		return *pattern == '\0';
+	}
+
+private:
+	static bool matchAny(const std::vector<std::string> &patterns, std::string_view name)
+	{
+		for (const std::string &pattern : patterns)
+		{
+			if (matchGlob(pattern.c_str(), name))
+				return true;
+		}
+
+		return false;
+	}
+};
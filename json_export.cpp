@@ -0,0 +1,347 @@
+#include "json_export.h"
+
+static const char* modifierName(Cpp::Type::Modifier modifier)
+{
+	switch (modifier)
+	{
+	case Cpp::Type::CONST:
+		return "const";
+	case Cpp::Type::POINTER_TO:
+		return "pointer";
+	case Cpp::Type::REFERENCE_TO:
+		return "reference";
+	case Cpp::Type::VOLATILE:
+		return "volatile";
+	}
+
+	return "unknown";
+}
+
+static const char* userTypeTag(Cpp::UserType *ut)
+{
+	switch (ut->type)
+	{
+	case Cpp::UserType::CLASS:
+		return "class";
+	case Cpp::UserType::UNION:
+		return "union";
+	case Cpp::UserType::STRUCT:
+		return "struct";
+	case Cpp::UserType::ENUM:
+		return "enum";
+	case Cpp::UserType::ARRAY:
+		return "array";
+	case Cpp::UserType::FUNCTION:
+		return "function";
+	}
+
+	return "unknown";
+}
+
+static void writeType(JsonWriter &json, Cpp::Type &type)
+{
+	json.beginObject();
+
+	if (type.isFundamentalType)
+	{
+		json.key("fund");
+		json.string(Cpp::FundamentalTypeToString(type.fundamentalType));
+	}
+	else
+	{
+		json.key("id");
+
+		if (type.userType)
+			json.number(type.userType->offset);
+		else
+			json.null();
+	}
+
+	if (!type.modifiers.empty())
+	{
+		json.key("modifiers");
+		json.beginArray();
+
+		for (Cpp::Type::Modifier modifier : type.modifiers)
+			json.string(modifierName(modifier));
+
+		json.endArray();
+	}
+
+	json.endObject();
+}
+
+static void writeVariables(JsonWriter &json, std::vector<Cpp::Variable> &variables)
+{
+	json.beginArray();
+
+	for (Cpp::Variable &v : variables)
+	{
+		json.beginObject();
+		json.key("name");
+		json.string(v.name);
+		json.key("type");
+		writeType(json, v.type);
+		json.endObject();
+	}
+
+	json.endArray();
+}
+
+static void writeParameters(JsonWriter &json, Cpp::FunctionType *f)
+{
+	json.key("returns");
+	writeType(json, f->returnType);
+
+	json.key("params");
+	json.beginArray();
+
+	for (Cpp::FunctionType::Parameter &p : f->parameters)
+	{
+		json.beginObject();
+		json.key("name");
+		json.string(p.name);
+		json.key("type");
+		writeType(json, p.type);
+		json.endObject();
+	}
+
+	json.endArray();
+}
+
+static void writeBlocks(JsonWriter &json, std::vector<Cpp::LexicalBlock> &blocks)
+{
+	json.beginArray();
+
+	for (Cpp::LexicalBlock &block : blocks)
+	{
+		json.beginObject();
+		json.key("start");
+		json.number(block.startAddress);
+		json.key("end");
+		json.number(block.endAddress);
+		json.key("locals");
+		writeVariables(json, block.variables);
+		json.key("blocks");
+		writeBlocks(json, block.blocks);
+		json.endObject();
+	}
+
+	json.endArray();
+}
+
+static void writeClass(JsonWriter &json, Cpp::ClassType *c)
+{
+	json.key("bases");
+	json.beginArray();
+
+	for (Cpp::ClassType::Inheritance &i : c->inheritances)
+	{
+		json.beginObject();
+		json.key("offset");
+		json.number(i.offset);
+		json.key("type");
+		writeType(json, i.type);
+		json.endObject();
+	}
+
+	json.endArray();
+
+	json.key("members");
+	json.beginArray();
+
+	for (Cpp::ClassType::Member &m : c->members)
+	{
+		json.beginObject();
+		json.key("name");
+		json.string(m.name);
+		json.key("offset");
+		json.number(m.offset);
+		json.key("size");
+		json.number(m.type.size());
+		json.key("padding");
+		json.number(m.padding);
+
+		if (m.bit_size != -1)
+		{
+			json.key("bitOffset");
+			json.number(m.bit_offset);
+			json.key("bitSize");
+			json.number(m.bit_size);
+		}
+
+		json.key("type");
+		writeType(json, m.type);
+		json.endObject();
+	}
+
+	json.endArray();
+
+	json.key("tailPadding");
+	json.number(c->tailPadding);
+}
+
+static void writeUserType(JsonWriter &json, Cpp::UserType *ut, int fileId)
+{
+	json.beginObject();
+	json.key("kind");
+	json.string("type");
+	json.key("id");
+	json.number(ut->offset);
+	json.key("file");
+	json.number(fileId);
+	json.key("tag");
+	json.string(userTypeTag(ut));
+	json.key("name");
+	json.string(ut->getName());
+	json.key("size");
+	json.number(ut->layoutSize);
+	json.key("align");
+	json.number(ut->layoutAlignment);
+
+	switch (ut->type)
+	{
+	case Cpp::UserType::CLASS:
+	case Cpp::UserType::UNION:
+	case Cpp::UserType::STRUCT:
+		if (ut->classData)
+			writeClass(json, ut->classData);
+		break;
+	case Cpp::UserType::ENUM:
+		if (ut->enumData)
+		{
+			json.key("base");
+			json.string(Cpp::FundamentalTypeToString(ut->enumData->baseType));
+			json.key("elements");
+			json.beginArray();
+
+			for (Cpp::EnumType::Element &e : ut->enumData->elements)
+			{
+				json.beginObject();
+				json.key("name");
+				json.string(e.name);
+				json.key("value");
+				json.number(e.constValue);
+				json.endObject();
+			}
+
+			json.endArray();
+		}
+		break;
+	case Cpp::UserType::ARRAY:
+		if (ut->arrayData)
+		{
+			json.key("element");
+			writeType(json, ut->arrayData->type);
+			json.key("dimensions");
+			json.beginArray();
+
+			for (Cpp::ArrayType::Dimension &d : ut->arrayData->dimensions)
+				json.number(d.size);
+
+			json.endArray();
+		}
+		break;
+	case Cpp::UserType::FUNCTION:
+		if (ut->functionData)
+			writeParameters(json, ut->functionData);
+		break;
+	}
+
+	json.endObject();
+	json.endLine();
+}
+
+static void writeFunction(JsonWriter &json, Cpp::Function &f, int fileId)
+{
+	json.beginObject();
+	json.key("kind");
+	json.string("function");
+	json.key("file");
+	json.number(fileId);
+	json.key("name");
+	json.string(f.name);
+	json.key("mangled");
+	json.string(f.mangledName);
+	json.key("global");
+	json.boolean(f.isGlobal);
+	json.key("start");
+	json.number(f.startAddress);
+	json.key("end");
+	json.number(f.endAddress);
+	json.key("owner");
+
+	if (f.typeOwner)
+		json.number(f.typeOwner->offset);
+	else
+		json.null();
+
+	writeParameters(json, &f);
+
+	// Locals are only written under the block that declares them
+	json.key("blocks");
+	writeBlocks(json, f.blocks);
+
+	// [line, character or -1, address] for each line record
+	json.key("lines");
+	json.beginArray();
+
+	if (f.dwarf)
+	{
+		const Dwarf::LineTable &lines = f.dwarf->lineTable;
+		std::pair<const Dwarf::LineTable::Chunk*, const Dwarf::LineTable::Chunk*> chunks = lines.findChunks(f.startAddress);
+
+		for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk)
+		{
+			for (size_t i = chunk->begin; i < chunk->end; i++)
+			{
+				json.beginArray();
+				json.number(lines.lineNumber[i]);
+				json.number(lines.charOffset[i]);
+				json.number(f.startAddress + lines.addressOffset[i]);
+				json.endArray();
+			}
+		}
+	}
+
+	json.endArray();
+
+	json.endObject();
+	json.endLine();
+}
+
+void writeJsonFile(JsonWriter &json, Cpp::File *cpp, int id)
+{
+	json.beginObject();
+	json.key("kind");
+	json.string("file");
+	json.key("id");
+	json.number(id);
+	json.key("name");
+	json.string(cpp->filename);
+	json.endObject();
+	json.endLine();
+
+	for (Cpp::UserType *ut : cpp->userTypes)
+		writeUserType(json, ut, id);
+
+	for (Cpp::Function &f : cpp->functions)
+		writeFunction(json, f, id);
+
+	for (Cpp::Variable &v : cpp->variables)
+	{
+		json.beginObject();
+		json.key("kind");
+		json.string("variable");
+		json.key("file");
+		json.number(id);
+		json.key("name");
+		json.string(v.name);
+		json.key("global");
+		json.boolean(v.isGlobal);
+		json.key("type");
+		writeType(json, v.type);
+		json.endObject();
+		json.endLine();
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "cpp.h"
+#include "json_writer.h"
+
+// Writes a converted file as JSON Lines records, one object per line, with
+// "kind" telling them apart. User types are referred to by the offset of
+// their DWARF entry, which stays the same from run to run.
+//
+//   {"kind":"file","id":0,"name":"C:\\SB\\Core\\x\\xEnt.cpp"}
+//   {"kind":"type","id":1234,"file":0,"tag":"struct","name":"xVec3","size":12,"align":4,...}
+//   {"kind":"function","file":0,"name":"Update","mangled":"Update__6zSceneFf","start":1048576,...}
+//   {"kind":"variable","file":0,"name":"gScene0","global":true,"type":{"id":1234}}
+//
+// A type reference is {"fund":"int"} or {"id":<type id>}, with a "modifiers"
+// array of "const", "pointer", "reference" and "volatile" in DWARF order if
+// there are any. Types are written before the functions and variables of
+// their file, but may refer to types of later files, or to types left out by
+// --type.
+//
+// A function's locals are written once, in the "locals" of the lexical block
+// that declares them: "blocks" is the tree of the function's blocks, each with
+// "start", "end", "locals" and its nested "blocks". The C++ output declares
+// the locals of the outermost blocks at the top of the function instead.
+void writeJsonFile(JsonWriter &json, Cpp::File *cpp, int id);
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "buffered_output.h"
+
+#include <charconv>
+#include <string_view>
+
+// Writes JSON straight to a buffered output as it is produced, without
+// building a document in memory. Commas are inserted automatically; the
+// caller is responsible for balancing begin/end calls. endLine() ends a
+// record, for JSON Lines output.
+class JsonWriter
+{
+public:
+	// filename "-" writes to stdout
+	JsonWriter(const char *filename) : m_output(filename)
+	{
+		m_needComma = false;
+	}
+
+	JsonWriter(const JsonWriter&) = delete;
+	JsonWriter& operator=(const JsonWriter&) = delete;
+
+	void beginObject()
+	{
+		separate();
+		m_output.put('{');
+		m_needComma = false;
+	}
+
+	void endObject()
+	{
+		m_output.put('}');
+		m_needComma = true;
+	}
+
+	void beginArray()
+	{
+		separate();
+		m_output.put('[');
+		m_needComma = false;
+	}
+
+	void endArray()
+	{
+		m_output.put(']');
+		m_needComma = true;
+	}
+
+	// The value written next belongs to this key
+	void key(std::string_view name)
+	{
+		separate();
+		writeString(name);
+		m_output.put(':');
+		m_needComma = false;
+	}
+
+	void string(std::string_view value)
+	{
+		separate();
+		writeString(value);
+		m_needComma = true;
+	}
+
+	void number(long long value)
+	{
+		char digits[24];
+		std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+
+		separate();
+		m_output.write(digits, result.ptr - digits);
+		m_needComma = true;
+	}
+
+	void boolean(bool value)
+	{
+		separate();
+
+		if (value)
+			m_output.write("true", 4);
+		else
+			m_output.write("false", 5);
+
+		m_needComma = true;
+	}
+
+	void null()
+	{
+		separate();
+		m_output.write("null", 4);
+		m_needComma = true;
+	}
+
+	void endLine()
+	{
+		m_output.put('\n');
+		m_needComma = false;
+	}
+
+	bool close()
+	{
+		return m_output.close();
+	}
+
+	bool hasError() const
+	{
+		return m_output.hasError();
+	}
+
+private:
+	BufferedOutput m_output;
+	bool m_needComma;
+
+	inline void separate()
+	{
+		if (m_needComma)
+			m_output.put(',');
+	}
+
+	// Valid UTF-8 is copied as is. Other bytes, such as names in a legacy
+	// code page, are written as the Latin-1 character with that value.
+	void writeString(std::string_view str)
+	{
+		static const char hex[] = "0123456789abcdef";
+
+		m_output.put('"');
+
+		size_t run = 0; // Start of the characters not written yet
+
+		for (size_t i = 0; i < str.size();)
+		{
+			unsigned char c = (unsigned char)str[i];
+			size_t length = (c < 0x80) ? 1 : utf8Length(str, i);
+
+			if (length > 0 && c >= 0x20 && c != '"' && c != '\\')
+			{
+				i += length;
+				continue;
+			}
+
+			m_output.write(str.data() + run, i - run);
+
+			if (c == '"' || c == '\\')
+			{
+				m_output.put('\\');
+				m_output.put((char)c);
+			}
+			else if (c == '\n')
+				m_output.write("\\n", 2);
+			else if (c == '\t')
+				m_output.write("\\t", 2);
+			else
+			{
+				char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+				m_output.write(escape, sizeof(escape));
+			}
+
+			run = ++i;
+		}
+
+		m_output.write(str.data() + run, str.size() - run);
+		m_output.put('"');
+	}
+
+	// The length of the UTF-8 sequence starting at `i`, or 0 if it isn't valid
+	static size_t utf8Length(std::string_view str, size_t i)
+	{
+		unsigned char c = (unsigned char)str[i];
+		size_t length;
+
+		if (c >= 0xc2 && c <= 0xdf)
+			length = 2;
+		else if (c >= 0xe0 && c <= 0xef)
+			length = 3;
+		else if (c >= 0xf0 && c <= 0xf4)
+			length = 4;
+		else
+			return 0;
+
+		if (i + length > str.size())
+			return 0;
+
+		for (size_t j = 1; j < length; j++)
+		{
+			if (((unsigned char)str[i + j] & 0xc0) != 0x80)
+				return 0;
+		}
+
+		return length;
+	}
+};
@@ -0,0 +1,156 @@
+#include "cpp.h"
+
+#include <algorithm>
+
+namespace Cpp
+{
+bool Type::isIndirect()
+{
+	for (Modifier modifier : modifiers)
+	{
+		if (modifier == POINTER_TO || modifier == REFERENCE_TO)
+			return true;
+	}
+
+	return false;
+}
+
+int Type::size()
+{
+	if (isIndirect())
+		return 4;
+
+	if (isFundamentalType)
+		return GetFundamentalTypeSize(fundamentalType);
+
+	if (!userType)
+		return -1;
+
+	computeLayout(userType);
+	return userType->layoutSize;
+}
+
+int Type::alignment()
+{
+	if (isIndirect())
+		return 4;
+
+	if (isFundamentalType)
+	{
+		int size = GetFundamentalTypeSize(fundamentalType);
+		return (size > 0) ? size : 1;
+	}
+
+	if (!userType)
+		return -1;
+
+	computeLayout(userType);
+	return userType->layoutAlignment;
+}
+
+static void computeClassLayout(UserType *ut)
+{
+	ClassType *c = ut->classData;
+
+	bool isUnion = (ut->type == UserType::UNION);
+	int alignment = 1;
+	int end = 0; // End of everything laid out so far
+
+	for (ClassType::Inheritance &i : c->inheritances)
+	{
+		alignment = std::max(alignment, i.type.alignment());
+		end = std::max(end, i.offset + std::max(i.type.size(), 0));
+	}
+
+	for (ClassType::Member &m : c->members)
+	{
+		int size = std::max(m.type.size(), 0);
+
+		alignment = std::max(alignment, m.type.alignment());
+
+		if (isUnion)
+		{
+			m.padding = 0;
+			end = std::max(end, size);
+		}
+		else
+		{
+			// Bitfields sharing a storage unit, or members out of order, overlap
+			// what came before them and get no padding
+			m.padding = std::max(0, m.offset - end);
+			end = std::max(end, m.offset + size);
+		}
+	}
+
+	int size = c->size;
+
+	// Without DW_AT_byte_size, the size is what the members need, rounded up
+	if (size <= 0)
+		size = (end + alignment - 1) / alignment * alignment;
+
+	c->tailPadding = std::max(0, size - end);
+
+	ut->layoutSize = size;
+	ut->layoutAlignment = alignment;
+}
+
+static void computeArrayLayout(UserType *ut)
+{
+	ArrayType *a = ut->arrayData;
+
+	int elementSize = a->type.size();
+	int count = 1;
+
+	for (ArrayType::Dimension &dimension : a->dimensions)
+		count *= dimension.size;
+
+	ut->layoutSize = (elementSize < 0) ? -1 : elementSize * count;
+	ut->layoutAlignment = a->type.alignment();
+}
+
+void computeLayout(UserType *ut)
+{
+	if (ut->layoutState != UserType::LAYOUT_PENDING)
+		return;
+
+	// A type that (invalidly) contains itself sees the size DWARF gave it, or
+	// -1, instead of recursing forever
+	ut->layoutState = UserType::LAYOUT_IN_PROGRESS;
+
+	switch (ut->type)
+	{
+	case UserType::CLASS:
+	case UserType::STRUCT:
+	case UserType::UNION:
+		if (ut->classData)
+		{
+			ut->layoutSize = ut->classData->size;
+			computeClassLayout(ut);
+		}
+		break;
+	case UserType::ARRAY:
+		if (ut->arrayData)
+			computeArrayLayout(ut);
+		break;
+	case UserType::FUNCTION:
+		ut->layoutSize = 4;
+		ut->layoutAlignment = 4;
+		break;
+	case UserType::ENUM:
+		if (ut->enumData)
+		{
+			ut->layoutSize = GetFundamentalTypeSize(ut->enumData->baseType);
+			ut->layoutAlignment = ut->layoutSize;
+		}
+		break;
+	}
+
+	ut->layoutState = UserType::LAYOUT_DONE;
+}
+
+void computeLayouts(const std::vector<UserType*> &userTypes)
+{
+	for (UserType *ut : userTypes)
+		computeLayout(ut);
+}
+}
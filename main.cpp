@@ -2,12 +2,32 @@
 #include "dwarf.h"
 #include "cpp.h"
 #include "symbol_table.h"
+#include "model_index.h"
+#include "converter.h"
+#include "dwarf2cpp.h"
+#include "server.h"
+#include "filter.h"
+#include "thread_pool.h"
+#include "tar_writer.h"
+#include "uring_writer.h"
+#include "file_watcher.h"
+#include "json_export.h"
+#include "column_export.h"
+#include "model_diff.h"
 
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
 
 // Cross-platform filesystem support
@@ -19,37 +39,47 @@
     namespace filesystem = std::experimental::filesystem;
 #endif
 
-std::vector<Cpp::File*> cppFiles;
-std::map<Dwarf::Entry*, Cpp::UserType*> entryUTPairs;
-std::map<std::string, std::vector<Cpp::UserType*>> nameUTListPairs;
-
-// Global symbol table for enhanced output
-SymbolTable g_symbolTable;
-
-int currentCompileUnitIndex = 0;
-
-Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename);
-void fixUserTypeNames();
-
-bool processDwarf(Dwarf *dwarf);
-bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
-bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var);
-bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
-bool processLocationAttr(Dwarf::Attribute *attr, int *location);
-bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
-bool processUserType(Dwarf::Entry *entry, Cpp::UserType *u);
-bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c);
-bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m);
-bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_);
-bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e);
-bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size);
-bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f);
-bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p);
-bool processFunction(Dwarf::Entry *entry, Cpp::Function *f);
-bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f);
-bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a);
-bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a);
-void replaceChar(char *str, char ch, char newCh);
+// What the command line asks for, see parseOptions()
+struct Settings
+{
+	// Compile units, types and functions selected, and whether only the types
+	// they use are written
+	Converter::Options options;
+
+	bool streaming = false;    // Convert and write one compile unit at a time, see runStreaming()
+	bool writeTar = false;     // Write the output files into one tar archive instead of a directory
+	bool writeJson = false;    // Write the converted files as JSON Lines instead of C++, see json_export.h
+	bool writeColumns = false; // Collect the converted files into columnar tables, see column_export.h
+	bool useUring = false;     // Write the output files through io_uring where the kernel supports it
+	bool watch = false;        // Convert again whenever the input file is rewritten, see runWatch()
+};
+
+// Where the converted files of one run go: the output directory, written
+// directly or through io_uring, or one tar archive, JSON Lines file or table
+// file. See openOutput(), writeCppFile() and closeOutput().
+struct Output
+{
+	std::string path;
+
+	std::unique_ptr<TarWriter> archive;
+	std::unique_ptr<JsonWriter> json;
+	int numJsonFiles = 0;
+	std::unique_ptr<ColumnExport> columns;
+	std::unique_ptr<UringWriter> uring;
+
+	// Output directories known to exist
+	std::unordered_set<std::string> createdDirectories;
+};
+
+filesystem::path getRelativeOutputPath(Cpp::File *cpp);
+filesystem::path getOutputPath(Cpp::File *cpp, const char *outDirectory);
+bool openOutput(Output *output, const Settings &settings, const char *outPath);
+void writeCppFile(Output &output, Cpp::File *cpp);
+bool closeOutput(Output &output, const SymbolTable &symbolTable);
+int runBatch(const char *manifestFilename, const Converter::Options &options);
+int runDiff(const char *oldFilename, const char *newFilename, const Converter::Options &options);
+int runWatch(const char *elfFilename, const char *outDirectory, const Converter::Options &options);
+int runStreaming(const char *elfFilename, Output &output, const Converter::Options &options);
 
 static inline std::string toHexString(int x)
 {
@@ -58,996 +88,882 @@ static inline std::string toHexString(int x)
 	return ss.str();
 }
 
-bool error(std::string errorMessage) {
-	std::cout << "ERROR: " << errorMessage << std::endl;
-	return false;
-}
-
-int main(int argc, char **argv)
+// Resolves one hex address per line of stdin and writes one result line per address to stdout
+int runLookup(const ModelIndex &index)
 {
-	if (argc != 3)
-	{
-		std::cout << "Usage: dwarf2cpp <input ELF file> <output directory>";
-		return 1;
-	}
-
-	char *elfFilename = argv[1];
-	char *outDirectory = argv[2];
-
-	std::cout << "Loading ELF file " << elfFilename << "..." << std::endl;
-
-	ElfFile *elf = new ElfFile(elfFilename);
-
-	if (elf->getError()) {
-		std::cout << "Failed to parse " << elfFilename << " as an ELF file. Error Code: " << elf->getError() << std::endl;
-		return 1;
-	}
-
-	// Load symbol table for enhanced output
-	std::cout << "Loading symbol table..." << std::endl;
-	if (!g_symbolTable.loadFromElf(elf)) {
-		std::cout << "Warning: Could not load symbol table. Output may have missing names." << std::endl;
-	}
+	std::ios::sync_with_stdio(false);
 
-	std::cout << "Loading DWARFv1 information..." << std::endl;
+	std::string line;
+	std::string out;
+	ModelIndex::AddressInfo info;
 
-	Dwarf *dwarf = new Dwarf(elf);
+	while (std::getline(std::cin, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
 
-	if (dwarf->getError()) {
-		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
-		return 1;
-	}
+		if (line.empty())
+			continue;
 
-	std::cout << "Converting DWARFv1 entries to C++ data..." << std::endl;
+		char *end;
+		unsigned long address = strtoul(line.c_str(), &end, 16);
 
-	if (!processDwarf(dwarf)) {
-		std::cout << "Failed to process DWARF data." << std::endl;
-		return 1;
-	}
+		if (*end != '\0')
+		{
+			out += line + "\tinvalid address\n";
+			continue;
+		}
 
-	std::cout << "Done converting DWARFv1 data!" << std::endl;
-	std::cout << "\tNumber of C++ files: " << cppFiles.size() << std::endl << std::endl;
+		index.lookupAddress((Elf32_Addr)address, &info);
+		out += index.formatAddress((Elf32_Addr)address, info);
+		out += '\n';
 
-	for (Cpp::File *cpp : cppFiles)
-	{
-		size_t pos;
-		while ((pos = cpp->filename.find("\\")) != std::string::npos)
+		if (out.size() >= 1 << 16)
 		{
-			cpp->filename.replace(pos, 1, "/");
+			std::cout.write(out.data(), out.size());
+			out.clear();
 		}
+	}
 
-		filesystem::path filename(cpp->filename);
-		filesystem::path path(outDirectory);
+	std::cout.write(out.data(), out.size());
+	std::cout.flush();
 
-		path /= filename.relative_path();
-		path = path.make_preferred();
+	return 0;
+}
 
-		filesystem::create_directories(path.parent_path());
+bool error(std::string errorMessage) {
+	std::cout << "ERROR: " << errorMessage << std::endl;
+	return false;
+}
 
-		std::cout << "Writing file " << path << "..." << std::endl;
+// Prints what a context ran into while loading a file
+void printErrors(const std::vector<Dwarf2Cpp::Error> &errors)
+{
+	for (const Dwarf2Cpp::Error &e : errors)
+		error(e.message);
+}
 
-		std::ofstream file(path);
-		file << cpp->toString(false, true);
-		file.close();
-	}
+// Prints the problems validation found in the .debug section, if any
+void printDiagnostics(const Dwarf *dwarf)
+{
+	if (dwarf->numProblems == 0)
+		return;
 
-	std::cout << "Done." << std::endl;
+	std::cout << "Warning: Found " << dwarf->numProblems << ((dwarf->numProblems == 1) ? " problem" : " problems") << " in the .debug section, decoding it with checks:" << std::endl;
 
-	return 0;
+	for (const Dwarf::Diagnostic &diagnostic : dwarf->diagnostics)
+		std::cout << "\t" << toHexString(diagnostic.offset) << ": " << diagnostic.message << std::endl;
+
+	if (dwarf->numProblems > dwarf->diagnostics.size())
+		std::cout << "\t... and " << (dwarf->numProblems - dwarf->diagnostics.size()) << " more" << std::endl;
 }
 
-Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename)
+// Removes the options from the arguments and records them in `settings`.
+// Returns false if an option is missing its pattern.
+bool parseOptions(int *argc, char **argv, Settings *settings)
 {
-	*outFilename = nullptr;
+	int out = 1;
 
-	size_t numAttributes = entry->attributes.size();
-
-	for (size_t i = 0; i < numAttributes; i++)
+	for (int i = 1; i < *argc; i++)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		std::vector<std::string> *patterns = nullptr;
 
-		if (attr->name == DW_AT_name)
+		if (strcmp(argv[i], "--stream") == 0)
 		{
-			*outFilename = attr->getString();
-			break;
+			settings->streaming = true;
+			continue;
 		}
-	}
 
-	if (*outFilename)
-	{
-		for (Cpp::File *cpp : cppFiles)
+		if (strcmp(argv[i], "--watch") == 0)
 		{
-			if (cpp->filename == *outFilename)
-				return cpp;
+			settings->watch = true;
+			continue;
 		}
-	}
 
-	return nullptr;
-}
-
-void fixUserTypeNames()
-{
-	for (auto const &x : nameUTListPairs)
-	{
-		bool noname = x.first.empty();
-		bool duplicate = x.second.size() > 1;
-
-		if (noname || duplicate)
+		if (strcmp(argv[i], "--tar") == 0)
 		{
-			for (size_t i = 0; i < x.second.size(); i++)
-			{
-				Cpp::UserType *ut = x.second[i];
-
-				if (noname)
-					ut->name = "type";
-
-				if (duplicate)
-					ut->name += "_" + std::to_string(i);
-			}
+			settings->writeTar = true;
+			continue;
 		}
-	}
-}
-
-bool processDwarf(Dwarf *dwarf)
-{
-	Dwarf::Entry *entry = &dwarf->entries.front();
 
-	while (entry)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_compile_unit:
-		case DW_TAG_MW_overlay_branch: // Metrowerks overlay branch - handle like compile unit
+		if (strcmp(argv[i], "--json") == 0)
 		{
-			const char *filename;
-			Cpp::File *cpp = findCppFile(entry, &filename);
-
-			bool found = (cpp != nullptr);
+			settings->writeJson = true;
+			continue;
+		}
 
-			if (!found)
-			{
-				cpp = new Cpp::File;
-				cpp->filename = filename;
-			}
+		if (strcmp(argv[i], "--columns") == 0)
+		{
+			settings->writeColumns = true;
+			continue;
+		}
 
-			if (!processCompileUnit(entry, cpp))
-				return error(std::string("Failed to processCompileUnit for '").append(cpp->filename).append("'"));
+		if (strcmp(argv[i], "--io-uring") == 0)
+		{
+			settings->useUring = true;
+			continue;
+		}
 
-			if (!found)
-				cppFiles.push_back(cpp);
+		if (strcmp(argv[i], "--reachable") == 0)
+		{
+			settings->options.reachableOnly = true;
+			continue;
+		}
 
-			//std::cout << "Found compile unit " << cpp->filename << std::endl;
-			//std::cout << "\t" << std::to_string(cpp->userTypes.size()) << " user types" << std::endl;
-			//std::cout << "\t" << std::to_string(cpp->variables.size()) << " variables" << std::endl;
+		if (strcmp(argv[i], "--cu") == 0)
+			patterns = &settings->options.filter.compileUnits;
+		else if (strcmp(argv[i], "--type") == 0)
+			patterns = &settings->options.filter.types;
+		else if (strcmp(argv[i], "--function") == 0)
+			patterns = &settings->options.filter.functions;
 
-			break;
-		}
+		if (!patterns)
+		{
+			argv[out++] = argv[i];
+			continue;
 		}
 
-		entry = entry->getSibling();
+		if (++i == *argc)
+			return false;
+
+		patterns->push_back(argv[i]);
 	}
 
+	*argc = out;
 	return true;
 }
 
-bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
+int main(int argc, char **argv)
 {
-	nameUTListPairs.clear();
+	Settings settings;
+	bool validOptions = parseOptions(&argc, argv, &settings);
+
+	bool serve = (argc == 4 && strcmp(argv[1], "serve") == 0);
+	bool lookup = (argc == 3 && strcmp(argv[1], "lookup") == 0);
+	bool batch = (argc == 3 && strcmp(argv[1], "batch") == 0);
+	bool diff = (argc == 4 && strcmp(argv[1], "diff") == 0);
+
+	// The other modes need every compile unit in memory at once, and don't
+	// write a single output directory
+	int numOutputFormats = (int)settings.writeTar + (int)settings.writeJson + (int)settings.writeColumns;
+
+	if ((settings.streaming || numOutputFormats > 0) && (serve || lookup || batch || diff))
+		validOptions = false;
+
+	if (numOutputFormats > 1)
+		validOptions = false;
+
+	// io_uring only writes C++ files into the output directory
+	if (settings.useUring && (numOutputFormats > 0 || serve || lookup || batch || diff))
+		validOptions = false;
+
+	// Watch mode writes C++ files into the output directory itself
+	if (settings.watch && (settings.streaming || settings.useUring || numOutputFormats > 0 || serve || lookup || batch || diff))
+		validOptions = false;
+
+	// Queries and comparisons look at the whole model
+	if (settings.options.reachableOnly && (serve || lookup || diff))
+		validOptions = false;
+
+	if ((argc != 3 && !serve && !diff) || !validOptions)
+	{
+		std::cout << "Usage: dwarf2cpp [options] <input ELF file> <output directory>" << std::endl;
+		std::cout << "       dwarf2cpp [options] --tar <input ELF file> <output tar file, or - for stdout>" << std::endl;
+		std::cout << "       dwarf2cpp [options] --json <input ELF file> <output JSON Lines file, or - for stdout>" << std::endl;
+		std::cout << "       dwarf2cpp [options] --columns <input ELF file> <output table file, or - for stdout>" << std::endl;
+		std::cout << "       dwarf2cpp [options] serve <input ELF file> <socket path>" << std::endl;
+		std::cout << "       dwarf2cpp [options] lookup <input ELF file> < addresses" << std::endl;
+		std::cout << "       dwarf2cpp [options] batch <manifest file>" << std::endl;
+		std::cout << "       dwarf2cpp [options] diff <old ELF file> <new ELF file>" << std::endl;
+		std::cout << "Options:" << std::endl;
+		std::cout << "  --cu <pattern>        only convert compile units whose path matches" << std::endl;
+		std::cout << "  --type <pattern>      only write user types whose name matches" << std::endl;
+		std::cout << "  --function <pattern>  only write functions whose name matches" << std::endl;
+		std::cout << "  --stream              convert and write one compile unit at a time to save memory" << std::endl;
+		std::cout << "  --watch               convert again whenever the input file is rewritten (Linux)" << std::endl;
+		std::cout << "  --tar                 write all files into one tar archive" << std::endl;
+		std::cout << "  --json                write the converted data as JSON Lines instead of C++" << std::endl;
+		std::cout << "  --columns             write the converted data as columnar binary tables instead of C++" << std::endl;
+		std::cout << "  --io-uring            write the C++ files in batches through io_uring on Linux; directories are created directly" << std::endl;
+		std::cout << "  --reachable           only write the user types that a file's variables and functions use" << std::endl;
+		return 1;
+	}
 
-	Dwarf::Entry *next = entry->getSibling();
-	size_t numAttributes = entry->attributes.size();
+	if (batch)
+		return runBatch(argv[2], settings.options);
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+	if (diff)
+		return runDiff(argv[2], argv[3], settings.options);
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			cpp->filename = attr->getString();
-			break;
-		}
-	}
+	if (settings.watch)
+		return runWatch(argv[1], argv[2], settings.options);
 
-	Dwarf::Entry *start = ++entry;
+	char *elfFilename = argv[(serve || lookup) ? 2 : 1];
+	char *outDirectory = argv[2];
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_class_type:
-		case DW_TAG_structure_type:
-		case DW_TAG_enumeration_type:
-		case DW_TAG_array_type:
-		case DW_TAG_subroutine_type:
-		case DW_TAG_union_type:
-		{
-			entryUTPairs[entry] = new Cpp::UserType;
-		}
-		}
+	// Lookup results and archives can go to stdout, so send progress messages
+	// to stderr until then
+	std::streambuf *stdoutBuffer = std::cout.rdbuf();
 
-		entry = entry->getSibling();
-	}
+	if (lookup || (numOutputFormats > 0 && strcmp(outDirectory, "-") == 0))
+		std::cout.rdbuf(std::cerr.rdbuf());
 
-	entry = start;
+	Output output;
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_global_variable:
-		case DW_TAG_local_variable:
-		{
-			Cpp::Variable var;
+	if (!openOutput(&output, settings, outDirectory))
+		return 1;
 
-			if (!processVariable(entry, &var))
-				return error("Failed to processVar.");
+	if (settings.streaming)
+		return runStreaming(elfFilename, output, settings.options);
 
-			cpp->variables.push_back(var);
-			break;
-		}
-		case DW_TAG_class_type:
-		case DW_TAG_structure_type:
-		case DW_TAG_enumeration_type:
-		case DW_TAG_array_type:
-		case DW_TAG_subroutine_type:
-		case DW_TAG_union_type:
-		{
-			Cpp::UserType *userType = entryUTPairs[entry];
-			processUserType(entry, userType);
+	Dwarf2Cpp context(settings.options);
+	context.setLog(&std::cout);
 
-			userType->index = cpp->userTypes.size();
-			cpp->userTypes.push_back(userType);
+	bool loaded = context.load(elfFilename);
 
-			nameUTListPairs[userType->name].push_back(userType);
-			break;
-		}
-		case DW_TAG_global_subroutine:
-		case DW_TAG_subroutine:
-		case DW_TAG_inlined_subroutine:
-		{
-			Cpp::Function f;
-			f.dwarf = entry->dwarf;
+	if (context.getDwarf())
+		printDiagnostics(context.getDwarf());
 
-			if (!processFunctionType(entry, &f))
-				return error("Failed to processFunctionType.");
+	printErrors(context.getErrors());
 
-			if (!processFunction(entry, &f))
-				return error("Failed to processFunction.");
+	if (!loaded)
+		return 1;
 
-			cpp->functions.push_back(f);
-		}
-		}
+	if (serve)
+		return runServer(context.getIndex(), argv[3]) ? 0 : 1;
 
-		entry = entry->getSibling();
+	if (lookup)
+	{
+		const ModelIndex &index = context.getIndex();
+		std::cout.rdbuf(stdoutBuffer);
+		return runLookup(index);
 	}
 
-	fixUserTypeNames();
+	for (Cpp::File *cpp : context.getFiles())
+		writeCppFile(output, cpp);
 
-	return true;
+	if (!closeOutput(output, context.getSymbolTable()))
+		return 1;
+
+	std::cout << "Done." << std::endl;
+
+	return 0;
 }
 
-bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var)
+// Opens a file for writing as a new inode. Batch mode hard links files with
+// the same contents, so writing through an existing path could change the
+// files linked to it as well.
+std::ofstream createFile(const filesystem::path &path, std::ios::openmode mode = std::ios::out)
 {
-	var->isGlobal = (entry->tag == DW_TAG_global_variable);
+	std::error_code ec;
+	filesystem::remove(path, ec);
 
-	size_t numAttributes = entry->attributes.size();
+	return std::ofstream(path, mode);
+}
+
+// Opens the archive, JSON Lines file, tables or io_uring the settings ask
+// for. Returns false if the output file can't be opened.
+bool openOutput(Output *output, const Settings &settings, const char *outPath)
+{
+	output->path = outPath;
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (settings.writeTar)
+		output->archive.reset(new TarWriter(outPath));
+
+	if (settings.writeJson)
+		output->json.reset(new JsonWriter(outPath));
+
+	if (settings.writeColumns)
+		output->columns.reset(new ColumnExport);
+
+	if (settings.useUring)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		output->uring.reset(new UringWriter);
 
-		switch (attr->name)
+		if (!output->uring->isAvailable())
 		{
-		case DW_AT_name:
-			var->name = attr->getString();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &var->type))
-				return error(std::string("Failed to processTypeAttr for variable '").append(var->name).append("'."));
-			break;
+			std::cout << "Warning: io_uring isn't available, writing files one at a time." << std::endl;
+			output->uring.reset();
 		}
 	}
 
+	if ((output->archive && output->archive->hasError()) || (output->json && output->json->hasError())) {
+		std::cout << "Failed to open " << outPath << " for writing." << std::endl;
+		return false;
+	}
+
 	return true;
 }
 
-bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type)
+void writeCppFile(Output &output, Cpp::File *cpp)
 {
-	Dwarf *dwarf = attr->dwarf;
-
-	switch (attr->name)
-	{
-	case DW_AT_fund_type:
+	if (output.columns)
 	{
-		type->isFundamentalType = true;
-		type->fundamentalType = (Cpp::FundamentalType)attr->getHword();
-		break;
+		output.columns->addFile(cpp);
+		return;
 	}
-	case DW_AT_user_def_type:
-	{
-		type->isFundamentalType = false;
-
-		if (!findUserType(dwarf, attr->getReference(), &type->userType))
-			return error(std::string("processTypeAttr failed when handling AT_user_def_type."));
 
-		break;
-	}
-	case DW_AT_mod_fund_type:
+	if (output.json)
 	{
-		type->isFundamentalType = true;
+		std::cout << "Exporting file " << cpp->filename << "..." << std::endl;
 
-		char *mod = attr->getBlock();
-		char *end = mod + attr->size - sizeof(Elf32_Half);
+		writeJsonFile(*output.json, cpp, output.numJsonFiles++);
+		return;
+	}
 
-		type->fundamentalType = (Cpp::FundamentalType)dwarf->read<Elf32_Half>(end);
+	if (output.archive)
+	{
+		std::string path = getRelativeOutputPath(cpp).generic_string();
 
-		while (mod < end)
-		{
-			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
-			mod++;
-		}
+		std::cout << "Adding file " << path << "..." << std::endl;
 
-		break;
+		output.archive->addFile(path, cpp->toString(false, true));
+		return;
 	}
-	case DW_AT_mod_u_d_type:
-	{
-		type->isFundamentalType = false;
 
-		char *mod = attr->getBlock();
-		char *end = mod + attr->size - sizeof(Elf32_Off);
+	filesystem::path path = getOutputPath(cpp, output.path.c_str());
+	filesystem::path directory = path.parent_path();
 
-		if (!findUserType(dwarf, dwarf->read<Elf32_Off>(end), &type->userType))
-			return error(std::string("processTypeAttr failed when handling AT_mod_u_d_type."));
+	// Many files share a directory
+	if (output.createdDirectories.insert(directory.string()).second)
+		filesystem::create_directories(directory);
 
-		while (mod < end)
-		{
-			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
-			mod++;
-		}
+	std::cout << "Writing file " << path << "..." << std::endl;
 
-		break;
-	}
+	if (output.uring)
+	{
+		output.uring->addFile(path.string(), cpp->toString(false, true));
+		return;
 	}
 
-	return true;
+	std::ofstream file = createFile(path);
+	file << cpp->toString(false, true);
+	file.close();
 }
 
-bool processLocationAttr(Dwarf::Attribute *attr, int *location)
+// Flushes the archive or JSON output, or writes the tables, if there are
+// any. Returns false if they couldn't be written.
+bool closeOutput(Output &output, const SymbolTable &symbolTable)
 {
-	// I don't really know how location is supposed to be handled,
-	// so I just look for a DW_OP_CONST and use that as the "location"
-
-	Dwarf *dwarf = attr->dwarf;
+	bool success = true;
 
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
-
-	while (block < end)
+	if (output.columns)
 	{
-		char op = dwarf->read<char>(block);
-		block += sizeof(char);
+		std::cout << "Writing tables to " << output.path << "..." << std::endl;
 
-		if (op == DW_OP_CONST)
-		{
-			*location = dwarf->read<Elf32_Word>(block);
-			break;
-		}
+		output.columns->addSymbols(symbolTable);
+		success = output.columns->write(output.path.c_str());
 	}
 
-	return true;
-}
-
-bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u)
-{
-	Dwarf::Entry *entry = dwarf->getEntryFromReference(ref);
+	if (output.uring && !output.uring->finish())
+	{
+		for (const std::string &path : output.uring->getFailedPaths())
+			error("Failed to write " + path);
 
-	if (!entry || entryUTPairs.count(entry) == 0)
-		return error(std::string("Failed to findUserType for reference '").append(std::to_string(ref)).append("'."));
+		return error(std::to_string(output.uring->getNumFailed()) + " file(s) couldn't be written.");
+	}
 
-	*u = entryUTPairs[entry];
+	if ((!output.archive || output.archive->close()) && (!output.json || output.json->close()) && success)
+		return true;
 
-	return true;
+	return error("Failed to write " + output.path);
 }
 
-bool processUserType(Dwarf::Entry *entry, Cpp::UserType *userType)
+// The compile unit's path without its root
+filesystem::path getRelativeOutputPath(Cpp::File *cpp)
 {
-	size_t numAttributes = entry->attributes.size();
+	std::string name(cpp->filename);
 
-	for (size_t i = 0; i < numAttributes; i++)
+	size_t pos;
+	while ((pos = name.find("\\")) != std::string::npos)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
-
-		switch (attr->name)
-		{
-		case DW_AT_name:
-		{
-			char *name = attr->getString();
-			replaceChar(name, '@', '_');
-			userType->name = name;
-			break;
-		}
-		}
+		name.replace(pos, 1, "/");
 	}
 
-	switch (entry->tag)
-	{
-	case DW_TAG_class_type:
-	case DW_TAG_structure_type:
-	case DW_TAG_union_type:
-		userType->type = (entry->tag == DW_TAG_structure_type) ? Cpp::UserType::STRUCT : ((entry->tag == DW_TAG_union_type) ? Cpp::UserType::UNION : Cpp::UserType::CLASS);
-		userType->classData = new Cpp::ClassType;
-		userType->classData->parent = userType;
-
-		if (!processClassType(entry, userType->classData))
-			return error(std::string("Failed to processClassType for user type '").append(userType->name).append("'."));
-
-		break;
-	case DW_TAG_enumeration_type:
-		userType->type = Cpp::UserType::ENUM;
-		userType->enumData = new Cpp::EnumType;
-
-		if (!processEnumType(entry, userType->enumData))
-			return error(std::string("Failed to processEnumType for user type '").append(userType->name).append("'."));
+	return filesystem::path(name).relative_path();
+}
 
-		break;
-	case DW_TAG_array_type:
-		userType->type = Cpp::UserType::ARRAY;
-		userType->arrayData = new Cpp::ArrayType;
+// Replaces the root of the compile unit's path with the output directory
+filesystem::path getOutputPath(Cpp::File *cpp, const char *outDirectory)
+{
+	filesystem::path path(outDirectory);
 
-		if (!processArrayType(entry, userType->arrayData))
-			return error(std::string("Failed to processArrayType for array type '").append(userType->name).append("'."));
+	path /= getRelativeOutputPath(cpp);
+	return path.make_preferred();
+}
 
-		break;
-	case DW_TAG_subroutine_type:
-		userType->type = Cpp::UserType::FUNCTION;
-		userType->functionData = new Cpp::FunctionType;
+// One line of a batch manifest together with everything loaded for it
+struct BatchInput
+{
+	std::string elfFilename;
+	std::string outDirectory;
 
-		if (!processFunctionType(entry, userType->functionData))
-			return error(std::string("Failed to processFunctionType for function type '").append(userType->name).append("'."));
+	Dwarf2Cpp context;
 
-		break;
+	BatchInput(const Converter::Options &options)
+		: context(options)
+	{
 	}
 
-	return true;
-}
+	std::atomic<size_t> pendingWrites{0};
+	bool failed = false;
+};
 
-bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c)
+// Output written so far in a batch, keyed by a hash of the file contents, so
+// identical files produced for different inputs are stored only once
+struct BatchOutput
 {
-	c->size = 0;
+	struct WrittenFile
+	{
+		filesystem::path path;
+		bool complete;
+	};
 
-	size_t numAttributes = entry->attributes.size();
+	std::mutex mutex;
+	std::unordered_map<uint64_t, WrittenFile> written;
+	std::atomic<size_t> numWritten{0};
+	std::atomic<size_t> numLinked{0};
+	std::atomic<size_t> numFailed{0};
 
-	for (size_t i = 0; i < numAttributes; i++)
+	static uint64_t hash(const char *data, size_t size)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		// 64-bit FNV-1a
+		uint64_t h = 14695981039346656037ull;
 
-		switch (attr->name)
+		for (size_t i = 0; i < size; i++)
 		{
-		case DW_AT_byte_size:
-			c->size = attr->getWord();
-			break;
+			h ^= (unsigned char)data[i];
+			h *= 1099511628211ull;
 		}
-	}
-
-	Dwarf::Entry *next = entry->getSibling();
-	Dwarf::Entry *first = entry;
 
-	int memberCount = 0;
-	entry++;
+		return h ^ size;
+	}
 
-	while (entry && entry < next)
+	static uint64_t hash(const std::string &contents)
 	{
-		if (entry->tag == DW_TAG_member)
-			memberCount++;
-
-		entry = entry->getSibling();
+		return hash(contents.data(), contents.size());
 	}
 
-	c->members.reserve(memberCount);
-	entry = first + 1;
+	static bool sameContents(const filesystem::path &path, const std::string &contents)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream ss;
+		ss << file.rdbuf();
+		return file.good() && ss.str() == contents;
+	}
 
-	while (entry && entry < next)
+	// Hard links `path` to an earlier file with the same contents, or writes it
+	void write(const filesystem::path &path, const std::string &contents)
 	{
-		switch (entry->tag)
+		uint64_t key = hash(contents);
+		filesystem::path original;
+
 		{
-		case DW_TAG_member:
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto it = written.find(key);
+
+			if (it == written.end())
+				written[key] = WrittenFile{ path, false };
+			else if (it->second.complete)
+				original = it->second.path;
+		}
+
+		if (!original.empty() && original != path && sameContents(original, contents))
 		{
-			Cpp::ClassType::Member m;
+			std::error_code ec;
 
-			if (!processMember(entry, &m))
-				return error("Failed to processMember for class type.");
+			filesystem::remove(path, ec);
+			filesystem::create_hard_link(original, path, ec);
 
-			c->members.push_back(m);
-			break;
+			if (!ec)
+			{
+				numLinked++;
+				return;
+			}
 		}
-		case DW_TAG_inheritance:
-			Cpp::ClassType::Inheritance i;
 
-			if (!processInheritance(entry, &i))
-				return error("Failed to processInheritance for class type.");
+		std::ofstream file = createFile(path, std::ios::binary);
+		file << contents;
+		file.close();
 
-			c->inheritances.push_back(i);
-			break;
+		if (!file)
+		{
+			numFailed++;
+			return;
 		}
 
-		entry = entry->getSibling();
-	}
+		numWritten++;
 
-	return true;
-}
+		std::lock_guard<std::mutex> lock(mutex);
 
-bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m)
+		auto it = written.find(key);
+
+		if (it != written.end() && it->second.path == path)
+			it->second.complete = true;
+	}
+};
+
+// Loads and converts an input. numThreads is passed on to Dwarf.
+bool loadBatchInput(BatchInput *input, unsigned numThreads)
 {
-	m->bit_offset = -1;
-	m->bit_size = -1;
+	bool loaded = input->context.load(input->elfFilename, numThreads);
 
-	size_t numAttributes = entry->attributes.size();
+	if (input->context.getDwarf())
+		printDiagnostics(input->context.getDwarf());
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+	printErrors(input->context.getErrors());
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			m->name = attr->getString();
-			break;
-		case DW_AT_bit_offset:
-			m->bit_offset = attr->getHword();
-			break;
-		case DW_AT_bit_size:
-			m->bit_size = attr->getWord();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &m->type))
-				return error(std::string("Failed to processTypeAttr for member '").append(m->name).append("'."));
-			break;
-		case DW_AT_location:
-			if (!processLocationAttr(attr, &m->offset))
-				return error(std::string("Failed to processLocationAttr for member '").append(m->name).append("'."));
-		}
-	}
+	if (!loaded)
+		return error(std::string("Failed to convert '").append(input->elfFilename).append("'."));
 
 	return true;
 }
 
-bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_)
+void releaseBatchInput(BatchInput *input)
+{
+	input->context.release();
+}
+
+// Reads "<ELF file> <output directory>" lines. The two paths are separated by
+// a tab, or by spaces if the line has no tab. Empty lines and lines starting
+// with '#' are ignored.
+bool readManifest(const char *manifestFilename, const Converter::Options &options, std::vector<std::unique_ptr<BatchInput>> &inputs)
 {
-	size_t numAttributes = entry->attributes.size();
+	std::ifstream manifest(manifestFilename);
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (!manifest)
+		return error(std::string("Failed to open manifest '").append(manifestFilename).append("'."));
+
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(manifest, line))
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		lineNumber++;
 
-		switch (attr->name)
-		{
-		case DW_AT_user_def_type:
-			if (!processTypeAttr(attr, &i_->type))
-				return error("Failed to processTypeAttr for inheritance.");
-			break;
-		case DW_AT_location:
-			if (!processLocationAttr(attr, &i_->offset))
-				return error("Failed to processLocationAttr for inheritance.");
-		}
-	}
+		size_t first = line.find_first_not_of(" \t\r");
+		size_t last = line.find_last_not_of(" \t\r");
 
-	return true;
-}
+		if (first == std::string::npos || line[first] == '#')
+			continue;
 
-bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e)
-{
-	int byte_size = 0;
-	size_t numAttributes = entry->attributes.size();
+		line = line.substr(first, last - first + 1);
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		size_t split = line.find('\t');
 
-		switch (attr->name)
-		{
-		case DW_AT_byte_size:
-			byte_size = attr->getWord();
-
-			switch (byte_size) {
-			case 1:
-				e->baseType = Cpp::FundamentalType::UNSIGNED_CHAR;
-				break;
-			case 2:
-				e->baseType = Cpp::FundamentalType::UNSIGNED_SHORT;
-				break;
-			case 4:
-				e->baseType = Cpp::FundamentalType::INT;
-				break;
-			case 8:
-				e->baseType = Cpp::FundamentalType::LONG;
-				break;
-			default:
-				return error(std::string("Unknown enum base type size for enum type. (Size: ").append(std::to_string(byte_size)).append(")"));
-				break;
-			}
-			break;
-		case DW_AT_element_list:
-			if (!processElementList(attr, e, byte_size))
-				return error("Failed to processElementList for enum type.");
-			break;
-		}
+		if (split == std::string::npos)
+			split = line.find(' ');
+
+		size_t second = (split == std::string::npos) ? std::string::npos : line.find_first_not_of(" \t", split);
+
+		if (second == std::string::npos)
+			return error(std::string("Manifest line ").append(std::to_string(lineNumber)).append(" needs an ELF file and an output directory."));
+
+		std::unique_ptr<BatchInput> input(new BatchInput(options));
+		input->elfFilename = line.substr(0, split);
+		input->outDirectory = line.substr(second);
+		inputs.push_back(std::move(input));
 	}
 
 	return true;
 }
 
-bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size)
+// Converts every input of a manifest. Each input is loaded, converted and
+// written as separate tasks on one thread pool, so inputs are converted in
+// parallel and their loading and writing overlap. Files with the same contents as one already
+// written are hard links to it.
+int runBatch(const char *manifestFilename, const Converter::Options &options)
 {
-	Dwarf *dwarf = attr->dwarf;
+	std::vector<std::unique_ptr<BatchInput>> inputs;
 
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
+	if (!readManifest(manifestFilename, options, inputs))
+		return 1;
 
-	while (block < end)
-	{
-		Cpp::EnumType::Element element;
+	BatchOutput output;
+	ThreadPool pool;
 
-		if (byte_size == 1) {
-			element.constValue = dwarf->read<unsigned char>(block);
-		}
-		else if (byte_size == 2) {
-			element.constValue = dwarf->read<unsigned short>(block);
-		}
-		else if (byte_size == 4) {
-			element.constValue = dwarf->read<int>(block);
-		}
-		else if (byte_size == 8) {
-			element.constValue = dwarf->read<long>(block);
-		}
-		
-		block += byte_size;
+	std::cout << "Converting " << inputs.size() << " ELF files on " << pool.size() << " threads..." << std::endl;
 
-		element.name = block;
-		block += element.name.size() + 1;
+	// A converted input holds its whole model until its files are written, so
+	// only one input per thread is started at a time, and each one that is
+	// done starts the next
+	std::atomic<size_t> nextInput(0);
+	std::function<void()> startNextInput;
 
-		e->elements.push_back(element);
-	}
+	auto finishInput = [&startNextInput](BatchInput *input) {
+		releaseBatchInput(input);
+		startNextInput();
+	};
 
-	return true;
-}
+	startNextInput = [&]() {
+		size_t i = nextInput++;
 
-bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f)
-{
-	Dwarf::Entry *next = entry->getSibling();
-	Dwarf::Entry *first = entry;
+		if (i >= inputs.size())
+			return;
 
-	int paramCount = 0;
-	entry++;
+		BatchInput *input = inputs[i].get();
 
-	while (entry && entry < next)
-	{
-		if (entry->tag == DW_TAG_formal_parameter)
-			paramCount++;
+		pool.submit([input, &pool, &output, &finishInput]() {
+			// Inputs are already decoded in parallel with each other
+			if (!loadBatchInput(input, 1))
+			{
+				input->failed = true;
+				finishInput(input);
+				return;
+			}
 
-		entry = entry->getSibling();
-	}
+			const std::vector<Cpp::File*> &files = input->context.getFiles();
 
-	f->parameters.reserve(paramCount);
-	entry = first;
+			if (files.empty())
+			{
+				finishInput(input);
+				return;
+			}
 
-	size_t numAttributes = entry->attributes.size();
+			input->pendingWrites = files.size();
 
-	for (size_t i = 0; i < numAttributes; i++)
-	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+			for (Cpp::File *cpp : files)
+			{
+				pool.submit([input, cpp, &output, &finishInput]() {
+					filesystem::path path = getOutputPath(cpp, input->outDirectory.c_str());
 
-		switch (attr->name)
-		{
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &f->returnType))
-				return error("Failed to processTypeAttr for function return type.");
-			break;
-		}
-	}
+					std::error_code ec;
+					filesystem::create_directories(path.parent_path(), ec);
 
-	entry++;
+					output.write(path, cpp->toString(false, true));
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_formal_parameter:
-			Cpp::FunctionType::Parameter p;
+					if (--input->pendingWrites == 0)
+						finishInput(input);
+				});
+			}
+		});
+	};
 
-			if (!processParameter(entry, &p))
-				return error("Failed to processParameter for function parameter.");
+	for (size_t i = 0; i < pool.size(); i++)
+		startNextInput();
 
-			f->parameters.push_back(p);
-		}
+	pool.wait();
 
-		entry = entry->getSibling();
+	size_t numFailedInputs = 0;
+
+	for (std::unique_ptr<BatchInput> &input : inputs)
+	{
+		if (input->failed)
+			numFailedInputs++;
 	}
 
-	return true;
+	std::cout << "Done. " << (inputs.size() - numFailedInputs) << " of " << inputs.size() << " ELF files converted, "
+		<< output.numWritten << " files written, " << output.numLinked << " linked to identical files";
+
+	if (output.numFailed)
+		std::cout << ", " << output.numFailed << " failed to write";
+
+	std::cout << "." << std::endl;
+
+	return (numFailedInputs || output.numFailed) ? 1 : 0;
 }
 
-bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p)
+// Converts both ELF files and writes their differences to stdout, see
+// model_diff.h. Returns 0 if there are none, 1 if there are, and 2 on errors.
+int runDiff(const char *oldFilename, const char *newFilename, const Converter::Options &options)
 {
-	size_t numAttributes = entry->attributes.size();
+	// Only the differences go to stdout
+	std::streambuf *stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+	BatchInput oldInput(options);
+	BatchInput newInput(options);
+	BatchInput *inputs[2] = { &oldInput, &newInput };
 
-	for (size_t i = 0; i < numAttributes; i++)
+	oldInput.elfFilename = oldFilename;
+	newInput.elfFilename = newFilename;
+
+	for (BatchInput *input : inputs)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		std::cout << "Loading " << input->elfFilename << "..." << std::endl;
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			p->name = attr->getString();
-			break;
-		case DW_AT_fund_type:
-		case DW_AT_user_def_type:
-		case DW_AT_mod_fund_type:
-		case DW_AT_mod_u_d_type:
-			if (!processTypeAttr(attr, &p->type))
-				return error(std::string("Failed to processTypeAttr for parameter '").append(p->name).append("'."));
-			break;
-		}
+		if (!loadBatchInput(input, 0))
+			return 2;
 	}
 
-	return true;
+	std::cout << "Comparing..." << std::endl;
+
+	std::string out;
+	size_t count = ModelDiff(oldInput.context.getFiles(), newInput.context.getFiles()).write(&out);
+
+	std::cout.rdbuf(stdoutBuffer);
+	std::cout << out;
+	std::cout.flush();
+
+	std::cerr << count << " differences." << std::endl;
+
+	for (BatchInput *input : inputs)
+		releaseBatchInput(input);
+
+	return count ? 1 : 0;
 }
 
-bool processFunction(Dwarf::Entry *entry, Cpp::Function *f)
+// What watch mode remembers of the last conversion
+struct WatchState
 {
-	f->isGlobal = (entry->tag == DW_TAG_global_subroutine);
+	std::unordered_map<std::string, uint64_t> files; // Output path -> hash of the contents written
+};
 
-	size_t numAttributes = entry->attributes.size();
+// Writes the files of a converted input whose contents differ from what was
+// written last time, and removes the files that are no longer produced
+void updateWatchOutput(BatchInput *input, WatchState *state, ThreadPool &pool)
+{
+	const std::vector<Cpp::File*> &cppFiles = input->context.getFiles();
 
-	for (size_t i = 0; i < numAttributes; i++)
+	size_t numFiles = cppFiles.size();
+	std::vector<std::string> paths(numFiles);
+	std::vector<uint64_t> hashes(numFiles);
+	std::vector<char> failed(numFiles, 0);
+	std::atomic<size_t> numWritten{0};
+
+	// Formatting is most of the work, so it runs in parallel even for files
+	// that turn out to be unchanged
+	for (size_t i = 0; i < numFiles; i++)
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
+		pool.submit([&, i]() {
+			filesystem::path path = getOutputPath(cppFiles[i], input->outDirectory.c_str());
+			std::string contents = cppFiles[i]->toString(false, true);
 
-		switch (attr->name)
-		{
-		case DW_AT_name:
-			f->name = attr->getString();
-			break;
-		case DW_AT_mangled_name:
-			f->mangledName = attr->getString();
-			break;
-		case DW_AT_low_pc:
-			f->startAddress = attr->getAddress();
-			break;
-		}
-	}
+			paths[i] = path.string();
+			hashes[i] = BatchOutput::hash(contents);
 
-	Dwarf::Entry *next = entry->getSibling();
+			auto previous = state->files.find(paths[i]);
 
-	entry++;
+			if (previous != state->files.end() && previous->second == hashes[i])
+				return;
 
-	while (entry && entry < next)
-	{
-		switch (entry->tag)
-		{
-		case DW_TAG_lexical_block:
-			if (!processLexicalBlock(entry, f))
-				return error(std::string("Failed to processLexicalBlock for function '").append(f->name).append("'."));
-		}
+			std::error_code ec;
+			filesystem::create_directories(path.parent_path(), ec);
 
-		entry = entry->getSibling();
-	}
+			std::ofstream file = createFile(path, std::ios::binary);
+			file << contents;
+			file.close();
 
-	f->typeOwner = nullptr;
-	if (f->parameters.size() > 0 && f->parameters[0].name.compare("this") == 0) {
-		f->typeOwner = f->parameters[0].type.userType;
-		f->parameters.erase(f->parameters.begin());
-		f->typeOwner->classData->functions.push_back(*f);
-	}
-	else if (f->mangledName.size() > 2) {
-		int foundAt = f->mangledName.rfind("__");
-		if (foundAt != -1) {
-			char temp;
-			std::stringstream length;
-			int i;
-			for (i = foundAt + 1; i < f->mangledName.size(); i++) {
-				temp = f->mangledName[i];
-				if (temp >= '0' && temp <= '9') {
-					length << temp;
-				}
-				else {
-					break;
-				}
+			if (!file)
+			{
+				failed[i] = 1;
+				return;
 			}
 
-			std::string lengthStr = length.str();
-			if (lengthStr.length() > 0) {
-				int lengthCount = std::stoi(lengthStr);
-				if (f->mangledName[i + lengthCount] == 'F') {
-					std::string className = f->mangledName.substr(i, lengthCount);
-
-					// I tried to access this from the named map, but I couldn't for the life of me figure out how to do it. C++ is terrible, no other languages have runtime libraries that silently fail like this. The map is empty even though the code that adds elements to the map is run. Good grief.
-					/*auto it = nameUTListPairs.find(className);
-					if (it != nameUTListPairs.end()) {
-						std::vector<Cpp::UserType*> vector = it->second;
-						if (vector.size() != 1)
-							std::cout << "Couldn't find good type for '" << className << "'. (" << vector.size() << ")" << std::endl;
-					}
-					else {
-						std::cout << "Couldn't find good type for '" << className << "'." << std::endl;
-					}*/
-						
-					
-					Cpp::UserType* type = nullptr;
-					for (std::map<Dwarf::Entry*, Cpp::UserType*>::iterator iter = entryUTPairs.begin(); iter != entryUTPairs.end(); ++iter)
-					{
-						Dwarf::Entry* k = iter->first;
-						Cpp::UserType* value = iter->second;
-						if (value->name.compare(className) == 0) {
-							type = value;
-							break;
-						}
-					}
-
-					if (type != nullptr) {
-						f->typeOwner = type;
-						f->typeOwner->classData->functions.push_back(*f);
-					}
-				}
-			}
-		}
+			numWritten++;
+		});
 	}
 
-	// Enhance function information with symbol table data
-	if (g_symbolTable.isLoaded()) {
-		// If function name is missing, try to get it from symbol table
-		if (f->name.empty() && f->startAddress != 0) {
-			const SymbolInfo* symbol = g_symbolTable.findByAddress(f->startAddress);
-			if (symbol && symbol->is_function) {
-				f->name = symbol->name;
-			}
-		}
-		
-		// If function address is missing, try to get it from symbol table
-		if (f->startAddress == 0 && !f->name.empty()) {
-			const SymbolInfo* symbol = g_symbolTable.findByName(f->name);
-			if (symbol && symbol->is_function) {
-				f->startAddress = symbol->address;
-			}
-		}
-	}
+	pool.wait();
 
-	return true;
-}
+	std::unordered_map<std::string, uint64_t> files;
 
-bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f)
-{
-	Dwarf::Entry *next = entry->getSibling();
+	for (size_t i = 0; i < numFiles; i++)
+	{
+		if (failed[i])
+			error("Failed to write " + paths[i]);
+		else
+			files[paths[i]] = hashes[i];
+	}
 
-	entry++;
+	size_t numRemoved = 0;
+	filesystem::path root = filesystem::path(input->outDirectory).make_preferred();
 
-	while (entry && entry < next)
+	for (auto &previous : state->files)
 	{
-		switch (entry->tag)
-		{
-		case DW_TAG_global_variable:
-		case DW_TAG_local_variable:
-		{
-			Cpp::Variable v;
-			
-			if (!processVariable(entry, &v))
-				return error(std::string("Failed to processVariable for local var lexical block in function '").append(f->name).append("'."));
+		std::error_code ec;
 
-			f->variables.push_back(v);
-			break;
-		}
-		}
+		if (files.count(previous.first) != 0 || !filesystem::remove(previous.first, ec))
+			continue;
+
+		numRemoved++;
 
-		entry = entry->getSibling();
+		// Directories left empty go as well, up to the output directory
+		filesystem::path directory = filesystem::path(previous.first).parent_path();
+
+		while (!directory.empty() && directory != root && filesystem::is_empty(directory, ec) && filesystem::remove(directory, ec))
+			directory = directory.parent_path();
 	}
 
-	return true;
+	state->files.swap(files);
+
+	std::cout << numWritten << " of " << numFiles << " files written, " << numRemoved << " removed." << std::endl;
 }
 
-bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a)
+// Converts the ELF file into the output directory like the default mode, and
+// again whenever it is rewritten, until the process is stopped. Each time the
+// whole file is decoded and converted, which takes a fraction of the time of
+// formatting and writing, and only files whose contents changed are written.
+int runWatch(const char *elfFilename, const char *outDirectory, const Converter::Options &options)
 {
-	size_t numAttributes = entry->attributes.size();
+	FileWatcher watcher(elfFilename);
 
-	for (size_t i = 0; i < numAttributes; i++)
+	if (!watcher.isAvailable())
 	{
-		Dwarf::Attribute *attr = &entry->attributes[i];
-
-		switch (attr->name)
-		{
-		case DW_AT_ordering:
-			if (attr->getHword() != DW_ORD_row_major) // meh
-				return error(std::string("processArrayType encountered ordering unsupported by dwarf2cpp! (").append(toHexString(attr->getHword())).append(")"));
-			break;
-		case DW_AT_subscr_data:
-			if (!processSubscriptData(attr, a))
-				return error("Failed to processSubscriptData.");
-		}
+		error("Watch mode needs inotify, which is only available on Linux.");
+		return 1;
 	}
 
-	return true;
-}
+	WatchState state;
+	ThreadPool pool;
 
-bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a)
-{
-	Dwarf *dwarf = attr->dwarf;
-
-	char *block = attr->getBlock();
-	char *end = block + attr->size;
-
-	while (block < end)
+	while (true)
 	{
-		char format = dwarf->read<char>(block);
-		block += sizeof(char);
-
-		if (format == DW_FMT_ET)
-		{
-			int typeAttrIndex;
-			Dwarf::Attribute *typeAttr;
-			Dwarf::Entry* entry = &dwarf->entries[attr->entryIndex];
-			Elf32_Off offset = dwarf->pointerToOffset(block);
+		auto start = std::chrono::steady_clock::now();
 
-			offset = dwarf->readAttribute(offset, entry, &typeAttrIndex);
-			block = dwarf->offsetToPointer(offset);
+		BatchInput input(options);
+		input.elfFilename = elfFilename;
+		input.outDirectory = outDirectory;
 
-			typeAttr = &entry->attributes[typeAttrIndex];
+		// The build rewrites the file while it may still be in use
+		input.context.setPrivateCopy(true);
 
-			if (!processTypeAttr(typeAttr, &a->type))
-				return error("Failed to processTypeAttr for subscript data DW_FMT_ET.");
+		std::cout << "Converting " << elfFilename << "..." << std::endl;
 
-			break;
-		}
-		else if (format == DW_FMT_FT_C_C)
+		// A half-written file fails to load; the rest of the build will
+		// trigger another attempt
+		if (loadBatchInput(&input, 0))
 		{
-			Elf32_Half fundType = dwarf->read<Elf32_Half>(block);
-			block += sizeof(Elf32_Half);
-
-			// Only long indices are supported
-			if (fundType != DW_FT_long)
-				return error(std::string("Subscript data DW_FMT_FT_C_C had unsupported fundamental indice type ").append(toHexString(fundType)).append(" in type '").append(a->toNameString("")).append("'."));
-
-			Elf32_Word lowBound = dwarf->read<Elf32_Word>(block);
-			block += sizeof(Elf32_Word);
+			updateWatchOutput(&input, &state, pool);
 
-			// Only indices starting at 0 are supported
-			if (lowBound != 0)
-				return error(std::string("Subscript data contained indices which did not start at zero! (Start at: '").append(toHexString(lowBound)).append("', Type: '").append(a->toNameString("")).append("')"));
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+			std::cout << "Done in " << elapsed.count() << " ms." << std::endl;
+		}
 
-			Elf32_Word highBound = dwarf->read<Elf32_Word>(block);
-			block += sizeof(Elf32_Word);
+		releaseBatchInput(&input);
 
-			Cpp::ArrayType::Dimension dimension;
-			dimension.size = highBound + 1;
+		std::cout << "Watching " << elfFilename << " for changes..." << std::endl;
 
-			a->dimensions.push_back(dimension);
-		}
-		else
+		if (!watcher.waitForChange())
 		{
-			// Only fundamental typed (long) indices and
-			// constant value bounds are supported
-			return error(std::string("Encountered subscript data format unsupported by dwarf2cpp! (").append(toHexString(format)).append(")"));
+			error(std::string("Failed to watch ").append(elfFilename));
+			return 1;
 		}
 	}
-
-	return true;
 }
 
-void replaceChar(char *str, char ch, char newCh)
+// Converts and writes one compile unit at a time, see Dwarf2Cpp::stream()
+int runStreaming(const char *elfFilename, Output &output, const Converter::Options &options)
 {
-	char *end = str + strlen(str);
+	Dwarf2Cpp context(options);
+	context.setLog(&std::cout);
 
-	while (str < end)
-	{
-		if (*str == ch)
-			*str = newCh;
-		str++;
-	}
+	// Files are written on the context's writer thread
+	Dwarf2Cpp::StreamStats stats;
+	bool streamed = context.stream(elfFilename, [&output](Cpp::File *cpp) { writeCppFile(output, cpp); }, &stats);
+
+	if (context.getDwarf())
+		printDiagnostics(context.getDwarf());
+
+	printErrors(context.getErrors());
+
+	// Whatever was written before a failure is still flushed
+	bool closed = closeOutput(output, context.getSymbolTable());
+
+	if (!streamed || !closed)
+		return 1;
+
+	std::cout << "Done. Wrote " << stats.numFiles << " files, kept at most " << stats.maxResidentUnits << " units in memory." << std::endl;
+
+	return 0;
 }
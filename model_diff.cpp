@@ -0,0 +1,483 @@
+#include "model_diff.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_set>
+
+// 64-bit FNV-1a over everything added
+struct Hasher
+{
+	uint64_t value = 14695981039346656037ull;
+
+	void add(uint64_t x)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			value ^= (x >> (i * 8)) & 0xff;
+			value *= 1099511628211ull;
+		}
+	}
+
+	void add(std::string_view str)
+	{
+		for (char c : str)
+		{
+			value ^= (unsigned char)c;
+			value *= 1099511628211ull;
+		}
+
+		add((uint64_t)str.size());
+	}
+};
+
+static std::string toHexString(unsigned int x)
+{
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), x ? "%#x" : "%x", x);
+	return buffer;
+}
+
+static const char* kindName(Cpp::UserType *ut)
+{
+	switch (ut->type)
+	{
+	case Cpp::UserType::CLASS:
+		return "class";
+	case Cpp::UserType::UNION:
+		return "union";
+	case Cpp::UserType::STRUCT:
+		return "struct";
+	case Cpp::UserType::ENUM:
+		return "enum";
+	case Cpp::UserType::ARRAY:
+		return "array";
+	case Cpp::UserType::FUNCTION:
+		return "function type";
+	}
+
+	return "type";
+}
+
+static bool isClass(Cpp::UserType *ut)
+{
+	return (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION) && ut->classData;
+}
+
+// Name of a function, unique within the program
+static std::string functionKey(Cpp::File *cpp, Cpp::Function &f)
+{
+	if (!f.mangledName.empty())
+		return std::string(f.mangledName);
+
+	if (f.isGlobal)
+		return std::string(f.name);
+
+	return std::string(cpp->filename) + ":" + std::string(f.name);
+}
+
+static std::string signatureString(Cpp::Function *f)
+{
+	std::string result = f->returnType.toString() + "(";
+
+	for (size_t i = 0; i < f->parameters.size(); i++)
+	{
+		if (i > 0)
+			result += ", ";
+
+		result += f->parameters[i].type.toString();
+	}
+
+	return result + ")";
+}
+
+ModelDiff::ModelDiff(const std::vector<Cpp::File*> &oldFiles, const std::vector<Cpp::File*> &newFiles)
+{
+	build(oldFiles, &m_old);
+	build(newFiles, &m_new);
+}
+
+void ModelDiff::addDefinition(std::unordered_map<std::string, Entity> &map, std::vector<std::string> &order, const std::string &name, const Definition &definition)
+{
+	auto result = map.emplace(name, Entity());
+	Entity &entity = result.first->second;
+
+	if (result.second)
+		order.push_back(name);
+
+	for (Definition &d : entity.definitions)
+	{
+		if (d.hash == definition.hash)
+			return;
+	}
+
+	entity.definitions.push_back(definition);
+}
+
+void ModelDiff::build(const std::vector<Cpp::File*> &files, Model *model)
+{
+	for (Cpp::File *cpp : files)
+	{
+		for (Cpp::UserType *ut : cpp->userTypes)
+		{
+			if (ut->name.empty())
+				continue;
+
+			addDefinition(model->types, model->typeOrder, Cpp::SanitizeName(ut->name), Definition{ hashUserType(ut), ut, nullptr });
+		}
+
+		for (Cpp::Function &f : cpp->functions)
+			addDefinition(model->functions, model->functionOrder, functionKey(cpp, f), Definition{ hashFunction(&f), nullptr, &f });
+	}
+
+	// The root hash doesn't depend on the order things were found in
+	model->hash = 0;
+
+	for (auto *map : { &model->types, &model->functions })
+	{
+		for (auto &pair : *map)
+		{
+			std::vector<uint64_t> hashes;
+
+			for (Definition &d : pair.second.definitions)
+				hashes.push_back(d.hash);
+
+			std::sort(hashes.begin(), hashes.end());
+
+			Hasher hasher;
+			hasher.add(pair.first);
+
+			for (uint64_t hash : hashes)
+				hasher.add(hash);
+
+			pair.second.hash = hasher.value;
+			model->hash += hasher.value + (map == &model->types ? 1 : 2);
+		}
+	}
+}
+
+uint64_t ModelDiff::hashTypeRef(Cpp::Type &type)
+{
+	Hasher hasher;
+
+	for (Cpp::Type::Modifier modifier : type.modifiers)
+		hasher.add((uint64_t)modifier);
+
+	if (type.isFundamentalType)
+		hasher.add((uint64_t)type.fundamentalType);
+	else if (!type.userType)
+		hasher.add(std::string_view("?"));
+	else if (!type.userType->name.empty())
+		hasher.add(Cpp::SanitizeName(type.userType->name)); // Compared on its own
+	else
+		hasher.add(hashUserType(type.userType));
+
+	return hasher.value;
+}
+
+uint64_t ModelDiff::hashUserType(Cpp::UserType *ut)
+{
+	auto it = m_typeHashes.find(ut);
+
+	if (it != m_typeHashes.end())
+		return it->second;
+
+	// Only unnamed types are followed into, and they can't refer to
+	// themselves, but don't loop forever on bad data
+	m_typeHashes[ut] = 0;
+
+	Hasher hasher;
+	hasher.add((uint64_t)ut->type);
+	hasher.add(Cpp::SanitizeName(ut->name));
+	hasher.add((uint64_t)ut->layoutSize);
+	hasher.add((uint64_t)ut->layoutAlignment);
+
+	if (isClass(ut))
+	{
+		for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+		{
+			hasher.add((uint64_t)i.offset);
+			hasher.add(hashTypeRef(i.type));
+		}
+
+		for (Cpp::ClassType::Member &m : ut->classData->members)
+		{
+			hasher.add(m.name);
+			hasher.add((uint64_t)m.offset);
+			hasher.add((uint64_t)m.bit_offset);
+			hasher.add((uint64_t)m.bit_size);
+			hasher.add(hashTypeRef(m.type));
+		}
+	}
+	else if (ut->type == Cpp::UserType::ENUM && ut->enumData)
+	{
+		hasher.add((uint64_t)ut->enumData->baseType);
+
+		for (Cpp::EnumType::Element &e : ut->enumData->elements)
+		{
+			hasher.add(e.name);
+			hasher.add((uint64_t)e.constValue);
+		}
+	}
+	else if (ut->type == Cpp::UserType::ARRAY && ut->arrayData)
+	{
+		hasher.add(hashTypeRef(ut->arrayData->type));
+
+		for (Cpp::ArrayType::Dimension &d : ut->arrayData->dimensions)
+			hasher.add((uint64_t)d.size);
+	}
+	else if (ut->type == Cpp::UserType::FUNCTION && ut->functionData)
+	{
+		hasher.add(hashTypeRef(ut->functionData->returnType));
+
+		for (Cpp::FunctionType::Parameter &p : ut->functionData->parameters)
+			hasher.add(hashTypeRef(p.type));
+	}
+
+	m_typeHashes[ut] = hasher.value;
+	return hasher.value;
+}
+
+uint64_t ModelDiff::hashFunction(Cpp::Function *f)
+{
+	Hasher hasher;
+	hasher.add(f->name);
+	hasher.add((uint64_t)f->isGlobal);
+	hasher.add((uint64_t)f->startAddress);
+	hasher.add((uint64_t)f->endAddress);
+	hasher.add(hashTypeRef(f->returnType));
+
+	for (Cpp::FunctionType::Parameter &p : f->parameters)
+		hasher.add(hashTypeRef(p.type));
+
+	return hasher.value;
+}
+
+void ModelDiff::diffTypes(const std::string &name, Cpp::UserType *a, Cpp::UserType *b, std::string *out, size_t *count)
+{
+	std::string prefix = "~ type " + name + ": ";
+	size_t before = *count;
+
+	auto report = [&](const std::string &change) {
+		*out += prefix + change + "\n";
+		(*count)++;
+	};
+
+	if (a->type != b->type)
+		report(std::string("kind ") + kindName(a) + " -> " + kindName(b));
+
+	if (a->layoutSize != b->layoutSize)
+		report("size " + toHexString(a->layoutSize) + " -> " + toHexString(b->layoutSize));
+
+	if (isClass(a) && isClass(b))
+	{
+		std::vector<Cpp::ClassType::Inheritance> &basesA = a->classData->inheritances;
+		std::vector<Cpp::ClassType::Inheritance> &basesB = b->classData->inheritances;
+		bool basesChanged = (basesA.size() != basesB.size());
+
+		for (size_t i = 0; i < basesA.size() && !basesChanged; i++)
+			basesChanged = (basesA[i].offset != basesB[i].offset || hashTypeRef(basesA[i].type) != hashTypeRef(basesB[i].type));
+
+		if (basesChanged)
+			report("base classes changed");
+
+		// Members are matched by name; unnamed ones by their position
+		auto memberKey = [](Cpp::ClassType::Member &m, size_t i) {
+			return m.name.empty() ? "#" + std::to_string(i) : std::string(m.name);
+		};
+
+		std::unordered_map<std::string, Cpp::ClassType::Member*> membersA;
+		std::unordered_set<std::string> keysB;
+
+		for (size_t i = 0; i < a->classData->members.size(); i++)
+			membersA.emplace(memberKey(a->classData->members[i], i), &a->classData->members[i]);
+
+		for (size_t i = 0; i < b->classData->members.size(); i++)
+		{
+			Cpp::ClassType::Member &mb = b->classData->members[i];
+			std::string key = memberKey(mb, i);
+			keysB.insert(key);
+
+			auto it = membersA.find(key);
+
+			if (it == membersA.end())
+			{
+				report("member added '" + mb.type.toString(std::string(mb.name)) + "' at " + toHexString(mb.offset));
+				continue;
+			}
+
+			Cpp::ClassType::Member &ma = *it->second;
+			std::string label = "member '" + key + "' ";
+
+			if (ma.offset != mb.offset)
+				report(label + "moved " + toHexString(ma.offset) + " -> " + toHexString(mb.offset));
+
+			if (ma.bit_offset != mb.bit_offset || ma.bit_size != mb.bit_size)
+				report(label + "bits " + std::to_string(ma.bit_offset) + ":" + std::to_string(ma.bit_size) + " -> " +
+					std::to_string(mb.bit_offset) + ":" + std::to_string(mb.bit_size));
+
+			if (hashTypeRef(ma.type) != hashTypeRef(mb.type))
+			{
+				std::string typeA = ma.type.toString();
+				std::string typeB = mb.type.toString();
+
+				if (typeA != typeB)
+					report(label + "type " + typeA + " -> " + typeB);
+				else
+					report(label + "type " + typeA + " changed");
+			}
+		}
+
+		for (size_t i = 0; i < a->classData->members.size(); i++)
+		{
+			Cpp::ClassType::Member &ma = a->classData->members[i];
+
+			if (keysB.count(memberKey(ma, i)) == 0)
+				report("member removed '" + ma.type.toString(std::string(ma.name)) + "'");
+		}
+	}
+	else if (a->type == Cpp::UserType::ENUM && b->type == Cpp::UserType::ENUM && a->enumData && b->enumData)
+	{
+		std::unordered_map<std::string_view, long> valuesA;
+		std::unordered_set<std::string_view> namesB;
+
+		for (Cpp::EnumType::Element &e : a->enumData->elements)
+			valuesA.emplace(e.name, e.constValue);
+
+		for (Cpp::EnumType::Element &e : b->enumData->elements)
+		{
+			namesB.insert(e.name);
+
+			auto it = valuesA.find(e.name);
+
+			if (it == valuesA.end())
+				report("value added " + std::string(e.name) + " = " + std::to_string(e.constValue));
+			else if (it->second != e.constValue)
+				report("value " + std::string(e.name) + " " + std::to_string(it->second) + " -> " + std::to_string(e.constValue));
+		}
+
+		for (Cpp::EnumType::Element &e : a->enumData->elements)
+		{
+			if (namesB.count(e.name) == 0)
+				report("value removed " + std::string(e.name));
+		}
+	}
+
+	// Member order, alignment, array dimensions and the like
+	if (*count == before)
+		report("definition changed");
+}
+
+void ModelDiff::diffFunctions(const std::string &name, Cpp::Function *a, Cpp::Function *b, std::string *out, size_t *count)
+{
+	std::string prefix = "~ function " + name + ": ";
+	size_t before = *count;
+
+	auto report = [&](const std::string &change) {
+		*out += prefix + change + "\n";
+		(*count)++;
+	};
+
+	std::string signatureA = signatureString(a);
+	std::string signatureB = signatureString(b);
+
+	if (signatureA != signatureB)
+		report("signature " + signatureA + " -> " + signatureB);
+
+	if (a->startAddress != b->startAddress)
+		report("address " + toHexString(a->startAddress) + " -> " + toHexString(b->startAddress));
+
+	if (a->endAddress - a->startAddress != b->endAddress - b->startAddress && a->endAddress && b->endAddress)
+		report("size " + toHexString(a->endAddress - a->startAddress) + " -> " + toHexString(b->endAddress - b->startAddress));
+
+	if (a->isGlobal != b->isGlobal)
+		report(b->isGlobal ? "now global" : "now static");
+
+	if (*count == before)
+		report("definition changed");
+}
+
+void ModelDiff::diffEntities(bool types, std::string *out, size_t *count)
+{
+	auto &mapA = types ? m_old.types : m_old.functions;
+	auto &mapB = types ? m_new.types : m_new.functions;
+	const char *what = types ? "type " : "function ";
+
+	for (const std::string &name : types ? m_old.typeOrder : m_old.functionOrder)
+	{
+		Entity &a = mapA[name];
+		auto it = mapB.find(name);
+
+		if (it == mapB.end())
+		{
+			*out += std::string("- ") + what + name + "\n";
+			(*count)++;
+			continue;
+		}
+
+		Entity &b = it->second;
+
+		if (a.hash == b.hash)
+			continue;
+
+		// Pair up the definitions that only one side has
+		std::vector<Definition*> onlyA;
+		std::vector<Definition*> onlyB;
+
+		for (Definition &d : a.definitions)
+		{
+			if (std::none_of(b.definitions.begin(), b.definitions.end(), [&](Definition &e) { return e.hash == d.hash; }))
+				onlyA.push_back(&d);
+		}
+
+		for (Definition &d : b.definitions)
+		{
+			if (std::none_of(a.definitions.begin(), a.definitions.end(), [&](Definition &e) { return e.hash == d.hash; }))
+				onlyB.push_back(&d);
+		}
+
+		size_t pairs = std::min(onlyA.size(), onlyB.size());
+
+		for (size_t i = 0; i < pairs; i++)
+		{
+			if (types)
+				diffTypes(name, onlyA[i]->type, onlyB[i]->type, out, count);
+			else
+				diffFunctions(name, onlyA[i]->function, onlyB[i]->function, out, count);
+		}
+
+		if (onlyA.size() != onlyB.size())
+		{
+			*out += std::string("~ ") + what + name + ": " + std::to_string(a.definitions.size()) + " -> " +
+				std::to_string(b.definitions.size()) + " distinct definitions\n";
+			(*count)++;
+		}
+	}
+
+	for (const std::string &name : types ? m_new.typeOrder : m_new.functionOrder)
+	{
+		if (mapA.count(name))
+			continue;
+
+		Definition &d = mapB[name].definitions.front();
+
+		if (types)
+			*out += std::string("+ type ") + name + " (" + kindName(d.type) + ", " + toHexString(d.type->layoutSize) + ")\n";
+		else
+			*out += std::string("+ function ") + name + " at " + toHexString(d.function->startAddress) + "\n";
+
+		(*count)++;
+	}
+}
+
+size_t ModelDiff::write(std::string *out)
+{
+	size_t count = 0;
+
+	if (m_old.hash == m_new.hash)
+		return 0;
+
+	diffEntities(true, out, &count);
+	diffEntities(false, out, &count);
+
+	return count;
+}
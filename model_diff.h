@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compares two converted models by structure. Every named user type and every
+// function gets a hash of its definition, and every model a hash over all of
+// them. Definitions are only compared in detail where the hashes differ, so
+// the cost of the comparison follows the size of the change.
+//
+// Types are matched by name and functions by mangled name (by name, and by
+// file for static functions, if they have none). A name whose definitions
+// differ between compile units is compared definition by definition. Unnamed
+// types are compared as part of whatever refers to them.
+//
+// Each difference is one line:
+//   + type <name> (<kind>, <size>)
+//   - type <name>
+//   ~ type <name>: <change>
+//   + function <name> at <address>
+//   - function <name>
+//   ~ function <name>: <change>
+class ModelDiff
+{
+public:
+	ModelDiff(const std::vector<Cpp::File*> &oldFiles, const std::vector<Cpp::File*> &newFiles);
+
+	// Appends a line for each difference and returns the number of lines
+	size_t write(std::string *out);
+
+private:
+	struct Definition
+	{
+		uint64_t hash;
+		Cpp::UserType *type;
+		Cpp::Function *function;
+	};
+
+	// Distinct definitions of one name, in the order they were found
+	struct Entity
+	{
+		std::vector<Definition> definitions;
+		uint64_t hash; // Over the definition hashes, in sorted order
+	};
+
+	struct Model
+	{
+		std::unordered_map<std::string, Entity> types;
+		std::unordered_map<std::string, Entity> functions;
+		std::vector<std::string> typeOrder; // Names in the order they were found, for stable output
+		std::vector<std::string> functionOrder;
+		uint64_t hash;
+	};
+
+	Model m_old;
+	Model m_new;
+
+	// Hashes of user types, including the unnamed types they refer to
+	std::unordered_map<Cpp::UserType*, uint64_t> m_typeHashes;
+
+	void build(const std::vector<Cpp::File*> &files, Model *model);
+	void addDefinition(std::unordered_map<std::string, Entity> &map, std::vector<std::string> &order, const std::string &name, const Definition &definition);
+
+	uint64_t hashUserType(Cpp::UserType *ut);
+	uint64_t hashTypeRef(Cpp::Type &type);
+	uint64_t hashFunction(Cpp::Function *f);
+
+	void diffTypes(const std::string &name, Cpp::UserType *a, Cpp::UserType *b, std::string *out, size_t *count);
+	void diffFunctions(const std::string &name, Cpp::Function *a, Cpp::Function *b, std::string *out, size_t *count);
+	void diffEntities(bool types, std::string *out, size_t *count);
+};
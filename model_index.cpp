@@ -0,0 +1,607 @@
+#include "model_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+// Same output as streaming with std::hex and std::showbase, without the stream
+static inline std::string toHexString(unsigned int x)
+{
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), x ? "%#x" : "%x", x);
+	return buffer;
+}
+
+static bool parseNumber(const std::string &s, unsigned long *out)
+{
+	if (s.empty())
+		return false;
+
+	char *end;
+	*out = strtoul(s.c_str(), &end, 0);
+
+	return *end == '\0';
+}
+
+static bool isIndirect(const Cpp::Type &type)
+{
+	for (Cpp::Type::Modifier mod : type.modifiers)
+		if (mod == Cpp::Type::POINTER_TO || mod == Cpp::Type::REFERENCE_TO)
+			return true;
+
+	return false;
+}
+
+// Appends every member of `c` that covers `offset`, then descends into members
+// that are themselves classes or arrays. `base` is the offset of `c` within the
+// queried type and `prefix` the member path leading to it.
+static void collectMembers(Cpp::ClassType *c, int offset, int base, const std::string &prefix, std::vector<std::string> &lines, int depth)
+{
+	if (depth > 32)
+		return;
+
+	for (Cpp::ClassType::Inheritance &i : c->inheritances)
+	{
+		Cpp::Type &type = i.type;
+
+		if (type.isFundamentalType || !type.userType || !type.userType->classData)
+			continue;
+
+		Cpp::ClassType *parent = type.userType->classData;
+
+		if (offset >= i.offset && offset < i.offset + parent->size)
+			collectMembers(parent, offset - i.offset, base + i.offset, prefix + type.userType->getName() + "::", lines, depth + 1);
+	}
+
+	for (Cpp::ClassType::Member &m : c->members)
+	{
+		Cpp::Type &type = m.type;
+
+		if (!type.isFundamentalType && !type.userType)
+			continue;
+
+		int size = type.size();
+
+		if (offset < m.offset || offset >= m.offset + std::max(size, 1))
+			continue;
+
+		std::string path = prefix + std::string(m.name);
+
+		lines.push_back(toHexString(base + m.offset) + " " + std::to_string(size) + " " + path + " " + type.toString());
+
+		if (type.isFundamentalType || isIndirect(type))
+			continue;
+
+		int rel = offset - m.offset;
+		Cpp::UserType *ut = type.userType;
+
+		switch (ut->type)
+		{
+		case Cpp::UserType::CLASS:
+		case Cpp::UserType::STRUCT:
+		case Cpp::UserType::UNION:
+			collectMembers(ut->classData, rel, base + m.offset, path + ".", lines, depth + 1);
+			break;
+		case Cpp::UserType::ARRAY:
+		{
+			Cpp::Type &element = ut->arrayData->type;
+
+			if (!element.isFundamentalType && !element.userType)
+				break;
+
+			int elementSize = element.size();
+
+			if (elementSize <= 0)
+				break;
+
+			// Turn the flat element index into one subscript per dimension
+			int index = rel / elementSize;
+			std::string subscripts;
+			std::vector<Cpp::ArrayType::Dimension> &dims = ut->arrayData->dimensions;
+
+			for (size_t d = 0; d < dims.size(); d++)
+			{
+				int stride = 1;
+
+				for (size_t e = d + 1; e < dims.size(); e++)
+					stride *= dims[e].size;
+
+				subscripts += "[" + std::to_string(index / stride) + "]";
+				index %= stride;
+			}
+
+			int elementOffset = m.offset + (rel / elementSize) * elementSize;
+
+			lines.push_back(toHexString(base + elementOffset) + " " + std::to_string(elementSize) + " " + path + subscripts + " " + element.toString());
+
+			if (!element.isFundamentalType && !isIndirect(element) && element.userType->classData &&
+				(element.userType->type == Cpp::UserType::CLASS || element.userType->type == Cpp::UserType::STRUCT || element.userType->type == Cpp::UserType::UNION))
+			{
+				collectMembers(element.userType->classData, rel % elementSize, base + elementOffset, path + subscripts + ".", lines, depth + 1);
+			}
+
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+ModelIndex::ModelIndex(const std::vector<Cpp::File*> &files, Dwarf *dwarf, const SymbolTable *symbolTable)
+{
+	m_dwarf = dwarf;
+	m_symbolTable = symbolTable;
+
+	for (Cpp::File *cpp : files)
+	{
+		for (Cpp::UserType *ut : cpp->userTypes)
+		{
+			TypeRef ref;
+			ref.file = cpp;
+			ref.type = ut;
+
+			m_types[ut->getName()].push_back(ref);
+		}
+
+		for (Cpp::Function &f : cpp->functions)
+		{
+			FunctionRef ref;
+			ref.file = cpp;
+			ref.function = &f;
+
+			m_functionsByName[std::string(f.name)].push_back(ref);
+
+			if (!f.mangledName.empty() && f.mangledName != f.name)
+				m_functionsByName[std::string(f.mangledName)].push_back(ref);
+
+			if (f.startAddress == 0)
+				continue;
+
+			FunctionRange range;
+			range.start = f.startAddress;
+			range.end = (f.endAddress > f.startAddress) ? f.endAddress : 0;
+			range.ref = ref;
+
+			if (range.end == 0 && m_symbolTable)
+			{
+				const SymbolInfo *symbol = m_symbolTable->findByAddress(range.start);
+
+				if (symbol && symbol->is_function && symbol->size > 0)
+					range.end = range.start + symbol->size;
+			}
+
+			range.firstScope = m_scopes.size();
+			addScopes(f.blocks, 0, "");
+			range.lastScope = m_scopes.size();
+
+			m_functionsByAddress.push_back(range);
+		}
+	}
+
+	std::stable_sort(m_functionsByAddress.begin(), m_functionsByAddress.end(), [](const FunctionRange &a, const FunctionRange &b) {
+		return a.start < b.start;
+	});
+
+	// Functions of unknown size are assumed to run up to the next function
+	Elf32_Addr nextStart = 0xffffffff;
+
+	for (size_t i = m_functionsByAddress.size(); i-- > 0;)
+	{
+		FunctionRange &range = m_functionsByAddress[i];
+
+		if (i + 1 < m_functionsByAddress.size() && m_functionsByAddress[i + 1].start > range.start)
+			nextStart = m_functionsByAddress[i + 1].start;
+
+		if (range.end == 0)
+			range.end = nextStart;
+	}
+
+	Elf32_Addr maxEnd = 0;
+
+	for (FunctionRange &range : m_functionsByAddress)
+	{
+		maxEnd = std::max(maxEnd, range.end);
+		range.maxEnd = maxEnd;
+	}
+}
+
+void ModelIndex::addScopes(std::vector<Cpp::LexicalBlock> &blocks, int depth, const std::string &outerLocals)
+{
+	for (Cpp::LexicalBlock &block : blocks)
+	{
+		Scope scope;
+		scope.start = block.startAddress;
+		scope.end = block.endAddress;
+		scope.depth = depth;
+		scope.locals = outerLocals;
+
+		for (Cpp::Variable &v : block.variables)
+		{
+			if (!scope.locals.empty())
+				scope.locals += ", ";
+
+			scope.locals += v.toString();
+		}
+
+		m_scopes.push_back(scope);
+		addScopes(block.blocks, depth + 1, scope.locals);
+	}
+}
+
+const std::vector<ModelIndex::TypeRef>* ModelIndex::findTypes(const std::string &name) const
+{
+	auto it = m_types.find(name);
+	return (it != m_types.end()) ? &it->second : nullptr;
+}
+
+const std::vector<ModelIndex::FunctionRef>* ModelIndex::findFunctions(const std::string &name) const
+{
+	auto it = m_functionsByName.find(name);
+	return (it != m_functionsByName.end()) ? &it->second : nullptr;
+}
+
+const ModelIndex::FunctionRange* ModelIndex::findFunctionContaining(Elf32_Addr address) const
+{
+	auto it = std::upper_bound(m_functionsByAddress.begin(), m_functionsByAddress.end(), address, [](Elf32_Addr a, const FunctionRange &f) {
+		return a < f.start;
+	});
+
+	// Walk back through the ranges starting at or before the address until no
+	// earlier range can reach it. The first hit is the innermost one.
+	while (it != m_functionsByAddress.begin())
+	{
+		--it;
+
+		if (it->maxEnd <= address)
+			break;
+
+		if (address < it->end)
+			return &*it;
+	}
+
+	return nullptr;
+}
+
+void ModelIndex::findLine(const FunctionRange &function, Elf32_Addr address, AddressInfo *info) const
+{
+	info->line = 0;
+	info->charOffset = -1;
+
+	if (!m_dwarf)
+		return;
+
+	const Dwarf::LineTable &table = m_dwarf->lineTable;
+
+	// Records are offsets from their chunk's address. Use the chunks of the
+	// function itself, or failing that the closest chunk below the address.
+	std::pair<const Dwarf::LineTable::Chunk*, const Dwarf::LineTable::Chunk*> chunks = table.findChunks(function.start);
+
+	if (chunks.first == chunks.second)
+	{
+		auto it = std::upper_bound(table.chunks.begin(), table.chunks.end(), address, Dwarf::LineTable::ChunkLess());
+
+		if (it == table.chunks.begin())
+			return;
+
+		chunks = table.findChunks((it - 1)->address);
+	}
+
+	bool found = false;
+	Elf32_Addr best = 0;
+
+	for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk)
+	{
+		for (size_t i = chunk->begin; i < chunk->end; i++)
+		{
+			Elf32_Addr recordAddress = chunk->address + table.addressOffset[i];
+
+			if (recordAddress > address || (found && recordAddress < best))
+				continue;
+
+			// An end record at or below the address means the address is past the last line
+			found = true;
+			best = recordAddress;
+			info->line = table.lineNumber[i];
+			info->charOffset = table.charOffset[i];
+		}
+	}
+}
+
+bool ModelIndex::lookupAddress(Elf32_Addr address, AddressInfo *info) const
+{
+	info->function = findFunctionContaining(address);
+	info->scopes.clear();
+	info->line = 0;
+	info->charOffset = -1;
+
+	if (!info->function)
+		return false;
+
+	// Nested blocks lie inside their parents, so the blocks containing the
+	// address come out of the pre-order list outermost first
+	for (size_t i = info->function->firstScope; i < info->function->lastScope; i++)
+	{
+		const Scope &scope = m_scopes[i];
+
+		if (scope.start <= address && address < scope.end)
+			info->scopes.push_back(&scope);
+	}
+
+	findLine(*info->function, address, info);
+
+	return true;
+}
+
+std::string ModelIndex::formatAddress(Elf32_Addr address, const AddressInfo &info) const
+{
+	std::string result = toHexString(address);
+
+	if (!info.function)
+		return result + "\t??";
+
+	const FunctionRef &ref = info.function->ref;
+	Cpp::Function *f = ref.function;
+
+	result += "\t";
+
+	if (f->typeOwner)
+		result += f->typeOwner->getName() + "::";
+
+	result += std::string(f->name) + "+" + toHexString(address - info.function->start);
+	result += "\t" + std::string(ref.file->filename) + ":" + (info.line ? std::to_string(info.line) : std::string("?"));
+	result += "\t";
+
+	if (info.scopes.empty())
+		result += "-";
+
+	for (size_t i = 0; i < info.scopes.size(); i++)
+	{
+		if (i > 0)
+			result += ">";
+
+		result += toHexString(info.scopes[i]->start) + "-" + toHexString(info.scopes[i]->end);
+	}
+
+	result += "\t";
+
+	if (info.scopes.empty() || info.scopes.back()->locals.empty())
+		result += "-";
+	else
+		result += info.scopes.back()->locals;
+
+	return result;
+}
+
+bool ModelIndex::queryType(const std::string &name, std::vector<std::string> &lines, std::string &error) const
+{
+	const std::vector<TypeRef> *types = findTypes(name);
+
+	if (!types)
+	{
+		error = "no type named '" + name + "'";
+		return false;
+	}
+
+	// The same type is usually defined in every compile unit that includes it; show the first
+	const TypeRef &ref = types->front();
+
+	lines.push_back("file " + std::string(ref.file->filename));
+	lines.push_back("count " + std::to_string(types->size()));
+
+	std::string definition;
+
+	if (ref.type->type == Cpp::UserType::ARRAY || ref.type->type == Cpp::UserType::FUNCTION)
+		definition = ref.type->toDeclarationString();
+	else
+		definition = ref.type->toDefinitionString(true);
+
+	std::stringstream ss(definition);
+	std::string line;
+
+	while (std::getline(ss, line))
+		lines.push_back(line);
+
+	return true;
+}
+
+bool ModelIndex::queryLayout(const std::string &name, std::vector<std::string> &lines, std::string &error) const
+{
+	const std::vector<TypeRef> *types = findTypes(name);
+
+	if (!types)
+	{
+		error = "no type named '" + name + "'";
+		return false;
+	}
+
+	Cpp::UserType *ut = types->front().type;
+
+	lines.push_back("size " + std::to_string(ut->layoutSize));
+	lines.push_back("align " + std::to_string(ut->layoutAlignment));
+
+	if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+		return true;
+
+	Cpp::ClassType *c = ut->classData;
+
+	for (Cpp::ClassType::Inheritance &i : c->inheritances)
+		lines.push_back(toHexString(i.offset) + " " + std::to_string(i.type.size()) + " 0 : " + i.type.toString());
+
+	for (Cpp::ClassType::Member &m : c->members)
+		lines.push_back(toHexString(m.offset) + " " + std::to_string(m.type.size()) + " " + std::to_string(m.padding) + " " + std::string(m.name) + " " + m.type.toString());
+
+	lines.push_back("tail " + std::to_string(c->tailPadding));
+
+	return true;
+}
+
+bool ModelIndex::queryMembers(const std::string &name, const std::string &offset, std::vector<std::string> &lines, std::string &error) const
+{
+	const std::vector<TypeRef> *types = findTypes(name);
+	unsigned long value;
+
+	if (!types)
+	{
+		error = "no type named '" + name + "'";
+		return false;
+	}
+
+	if (!parseNumber(offset, &value))
+	{
+		error = "invalid offset '" + offset + "'";
+		return false;
+	}
+
+	Cpp::UserType *ut = types->front().type;
+
+	if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+	{
+		error = "'" + name + "' is not a class, struct or union";
+		return false;
+	}
+
+	collectMembers(ut->classData, (int)value, 0, "", lines, 0);
+
+	return true;
+}
+
+bool ModelIndex::queryFunction(const std::string &what, std::vector<std::string> &lines, std::string &error) const
+{
+	unsigned long address;
+
+	if (parseNumber(what, &address))
+	{
+		const FunctionRange *range = findFunctionContaining((Elf32_Addr)address);
+
+		if (!range)
+		{
+			error = "no function contains " + toHexString((unsigned int)address);
+			return false;
+		}
+
+		lines.push_back(toHexString(range->start) + " " + std::string(range->ref.file->filename) + " " + range->ref.function->toNameString());
+		return true;
+	}
+
+	const std::vector<FunctionRef> *functions = findFunctions(what);
+
+	if (!functions)
+	{
+		error = "no function named '" + what + "'";
+		return false;
+	}
+
+	for (const FunctionRef &ref : *functions)
+		lines.push_back(toHexString(ref.function->startAddress) + " " + std::string(ref.file->filename) + " " + ref.function->toNameString());
+
+	return true;
+}
+
+bool ModelIndex::queryLines(const std::string &address, std::vector<std::string> &lines, std::string &error) const
+{
+	unsigned long value;
+
+	if (!parseNumber(address, &value))
+	{
+		error = "invalid address '" + address + "'";
+		return false;
+	}
+
+	const FunctionRange *range = findFunctionContaining((Elf32_Addr)value);
+
+	if (!range)
+	{
+		error = "no function contains " + toHexString((unsigned int)value);
+		return false;
+	}
+
+	Cpp::Function *f = range->ref.function;
+	lines.push_back("function " + toHexString(f->startAddress) + " " + std::string(range->ref.file->filename) + " " + std::string(f->name));
+
+	if (!m_dwarf)
+		return true;
+
+	const Dwarf::LineTable &table = m_dwarf->lineTable;
+	std::pair<const Dwarf::LineTable::Chunk*, const Dwarf::LineTable::Chunk*> chunks = table.findChunks(f->startAddress);
+
+	// The record covering the address is the last one that starts at or before it
+	size_t match = (size_t)-1;
+
+	for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk)
+		for (size_t i = chunk->begin; i < chunk->end; i++)
+			if (table.lineNumber[i] != 0 && f->startAddress + table.addressOffset[i] <= value)
+				match = i;
+
+	for (const Dwarf::LineTable::Chunk *chunk = chunks.first; chunk != chunks.second; ++chunk)
+	{
+		for (size_t i = chunk->begin; i < chunk->end; i++)
+		{
+			std::string line = toHexString(f->startAddress + table.addressOffset[i]) + " " +
+				std::to_string(table.lineNumber[i]) + " " + std::to_string(table.charOffset[i]);
+
+			if (i == match)
+				line += " *";
+
+			lines.push_back(line);
+		}
+	}
+
+	return true;
+}
+
+std::string ModelIndex::query(const std::string &request) const
+{
+	std::stringstream ss(request);
+	std::string command;
+	std::vector<std::string> args;
+	std::string arg;
+
+	ss >> command;
+
+	while (ss >> arg)
+		args.push_back(arg);
+
+	std::vector<std::string> lines;
+	std::string error;
+	bool ok;
+
+	if (command == "type" && args.size() == 1)
+		ok = queryType(args[0], lines, error);
+	else if (command == "layout" && args.size() == 1)
+		ok = queryLayout(args[0], lines, error);
+	else if (command == "members" && args.size() == 2)
+		ok = queryMembers(args[0], args[1], lines, error);
+	else if (command == "function" && args.size() == 1)
+		ok = queryFunction(args[0], lines, error);
+	else if (command == "lines" && args.size() == 1)
+		ok = queryLines(args[0], lines, error);
+	else if (command == "lookup" && args.size() == 1)
+	{
+		unsigned long address;
+		AddressInfo info;
+
+		ok = parseNumber(args[0], &address);
+
+		if (!ok)
+			error = "invalid address '" + args[0] + "'";
+		else
+			lines.push_back(lookupAddress((Elf32_Addr)address, &info) ? formatAddress((Elf32_Addr)address, info) : toHexString((unsigned int)address) + "\t??");
+	}
+	else
+	{
+		ok = false;
+		error = "unknown request '" + request + "'";
+	}
+
+	if (!ok)
+		return "ERR " + error + "\n";
+
+	std::string response = "OK " + std::to_string(lines.size()) + "\n";
+
+	for (const std::string &line : lines)
+		response += line + "\n";
+
+	return response;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cpp.h"
+#include "dwarf.h"
+#include "symbol_table.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Lookup tables over a converted model, built once and then only read from.
+// Every query method is safe to call from several threads at once.
+//
+// Queries are single lines of text, answered by "OK <n>" followed by n lines,
+// or by "ERR <message>":
+//   type <name>               definition of a user type
+//   layout <type>             size, alignment and member padding of a user type
+//   members <type> <offset>   members (and nested members) covering a byte offset
+//   function <name|address>   functions by name, or the function containing an address
+//   lines <address>           line records of the function containing an address
+//   lookup <address>          function, lexical blocks, locals and line of an address
+class ModelIndex
+{
+public:
+	struct TypeRef
+	{
+		Cpp::File *file;
+		Cpp::UserType *type;
+	};
+
+	struct FunctionRef
+	{
+		Cpp::File *file;
+		Cpp::Function *function;
+	};
+
+	// A function's address range. `end` is exclusive; when DWARF has no
+	// DW_AT_high_pc it comes from the symbol size, or is 0 if that is unknown too.
+	struct FunctionRange
+	{
+		Elf32_Addr start;
+		Elf32_Addr end;
+		Elf32_Addr maxEnd; // Largest `end` of this and every earlier range, for overlap queries
+		FunctionRef ref;
+		size_t firstScope;
+		size_t lastScope;
+	};
+
+	// A lexical block, flattened in pre-order so that a block's nested blocks
+	// directly follow it. `locals` holds every variable in scope inside the
+	// block, including those of the enclosing blocks, already formatted.
+	struct Scope
+	{
+		Elf32_Addr start;
+		Elf32_Addr end;
+		int depth;
+		std::string locals;
+	};
+
+	// Everything known about one address
+	struct AddressInfo
+	{
+		const FunctionRange *function;
+		std::vector<const Scope*> scopes; // Outermost first
+		int line;                         // 0 if unknown
+		short charOffset;
+	};
+
+	ModelIndex(const std::vector<Cpp::File*> &files, Dwarf *dwarf, const SymbolTable *symbolTable);
+
+	// Answers one request line and returns the full response, including the trailing newline
+	std::string query(const std::string &request) const;
+
+	const std::vector<TypeRef>* findTypes(const std::string &name) const;
+	const std::vector<FunctionRef>* findFunctions(const std::string &name) const;
+	const FunctionRange* findFunctionContaining(Elf32_Addr address) const;
+
+	// Resolves an address to its function, lexical blocks and source line.
+	// Returns false if no function contains it.
+	bool lookupAddress(Elf32_Addr address, AddressInfo *info) const;
+
+	// Formats the result of lookupAddress as one tab-separated line
+	std::string formatAddress(Elf32_Addr address, const AddressInfo &info) const;
+
+private:
+	std::unordered_map<std::string, std::vector<TypeRef>> m_types;
+	std::unordered_map<std::string, std::vector<FunctionRef>> m_functionsByName;
+	std::vector<FunctionRange> m_functionsByAddress; // Sorted by start
+	std::vector<Scope> m_scopes;
+
+	void addScopes(std::vector<Cpp::LexicalBlock> &blocks, int depth, const std::string &outerLocals);
+	void findLine(const FunctionRange &function, Elf32_Addr address, AddressInfo *info) const;
+
+	Dwarf *m_dwarf;
+	const SymbolTable *m_symbolTable;
+
+	bool queryType(const std::string &name, std::vector<std::string> &lines, std::string &error) const;
+	bool queryLayout(const std::string &name, std::vector<std::string> &lines, std::string &error) const;
+	bool queryMembers(const std::string &name, const std::string &offset, std::vector<std::string> &lines, std::string &error) const;
+	bool queryFunction(const std::string &what, std::vector<std::string> &lines, std::string &error) const;
+	bool queryLines(const std::string &address, std::vector<std::string> &lines, std::string &error) const;
+};
@@ -0,0 +1,128 @@
+#include "cpp.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace Cpp
+{
+// User types found so far, and the ones whose references haven't been
+// followed yet
+struct Reachability
+{
+	std::unordered_set<UserType*> reached;
+	std::vector<UserType*> pending;
+
+	void addUserType(UserType *ut)
+	{
+		if (ut && reached.insert(ut).second)
+			pending.push_back(ut);
+	}
+
+	void addType(Type &type)
+	{
+		if (!type.isFundamentalType)
+			addUserType(type.userType);
+	}
+
+	void addVariables(std::vector<Variable> &variables)
+	{
+		for (Variable &var : variables)
+			addType(var.type);
+	}
+
+	void addFunctionType(FunctionType &f)
+	{
+		addType(f.returnType);
+
+		for (FunctionType::Parameter &p : f.parameters)
+			addType(p.type);
+	}
+
+	void addBlocks(std::vector<LexicalBlock> &blocks)
+	{
+		for (LexicalBlock &block : blocks)
+		{
+			addVariables(block.variables);
+			addBlocks(block.blocks);
+		}
+	}
+
+	void addFunction(Function &f)
+	{
+		addFunctionType(f);
+		addVariables(f.variables);
+		addBlocks(f.blocks);
+		addUserType(f.typeOwner);
+	}
+
+	// Follows the references of a type found earlier
+	void follow(UserType *ut)
+	{
+		switch (ut->type)
+		{
+		case UserType::CLASS:
+		case UserType::STRUCT:
+		case UserType::UNION:
+			if (!ut->classData)
+				break;
+
+			for (ClassType::Inheritance &i : ut->classData->inheritances)
+				addType(i.type);
+
+			for (ClassType::Member &m : ut->classData->members)
+				addType(m.type);
+
+			// Only their declarations are part of the class
+			for (Function &f : ut->classData->functions)
+				addFunctionType(f);
+
+			break;
+		case UserType::ARRAY:
+			if (ut->arrayData)
+				addType(ut->arrayData->type);
+			break;
+		case UserType::FUNCTION:
+			if (ut->functionData)
+				addFunctionType(*ut->functionData);
+			break;
+		case UserType::ENUM:
+			break;
+		}
+	}
+};
+
+void removeUnreachableTypes(File *file, const std::function<bool(UserType*)> &isRoot)
+{
+	Reachability reachability;
+
+	reachability.addVariables(file->variables);
+
+	for (Function &f : file->functions)
+		reachability.addFunction(f);
+
+	if (isRoot)
+	{
+		for (UserType *ut : file->userTypes)
+		{
+			if (isRoot(ut))
+				reachability.addUserType(ut);
+		}
+	}
+
+	while (!reachability.pending.empty())
+	{
+		UserType *ut = reachability.pending.back();
+		reachability.pending.pop_back();
+		reachability.follow(ut);
+	}
+
+	auto removed = std::remove_if(file->userTypes.begin(), file->userTypes.end(), [&](UserType *ut) {
+		return reachability.reached.count(ut) == 0;
+	});
+
+	file->userTypes.erase(removed, file->userTypes.end());
+
+	for (size_t i = 0; i < file->userTypes.size(); i++)
+		file->userTypes[i]->index = (int)i;
+}
+}
@@ -0,0 +1,211 @@
+#include "server.h"
+#include "thread_pool.h"
+
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <csignal>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// Clients that can be served at the same time; later ones wait for a worker
+static const unsigned MAX_CLIENTS = 16;
+
+// The sockets of the clients being served, so that the server can stop them
+class ClientSet
+{
+public:
+	// Returns false once the server is stopping
+	bool add(int fd)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_stopping)
+			return false;
+
+		m_fds.insert(fd);
+		return true;
+	}
+
+	void remove(int fd)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fds.erase(fd);
+	}
+
+	// Wakes every client blocked in read() and turns away the ones still queued
+	void stop()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+
+		for (int fd : m_fds)
+			shutdown(fd, SHUT_RDWR);
+	}
+
+private:
+	std::mutex m_mutex;
+	std::set<int> m_fds;
+	bool m_stopping = false;
+};
+
+static bool writeAll(int fd, const std::string &data)
+{
+	size_t written = 0;
+
+	while (written < data.size())
+	{
+		ssize_t n = write(fd, data.data() + written, data.size() - written);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		written += n;
+	}
+
+	return true;
+}
+
+static void serveClient(const ModelIndex &index, ClientSet &clients, int fd)
+{
+	if (!clients.add(fd))
+	{
+		close(fd);
+		return;
+	}
+
+	char buffer[4096];
+	std::string pending;
+	bool open = true;
+
+	while (open)
+	{
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			break;
+
+		pending.append(buffer, n);
+
+		// Answer every complete line; pipelined requests are answered in order
+		std::string responses;
+		size_t start = 0;
+		size_t end;
+
+		while ((end = pending.find('\n', start)) != std::string::npos)
+		{
+			std::string request = pending.substr(start, end - start);
+			start = end + 1;
+
+			if (!request.empty() && request.back() == '\r')
+				request.pop_back();
+
+			if (request.empty())
+				continue;
+
+			if (request == "quit")
+			{
+				open = false;
+				break;
+			}
+
+			responses += index.query(request);
+		}
+
+		pending.erase(0, start);
+
+		if (!responses.empty() && !writeAll(fd, responses))
+			break;
+	}
+
+	clients.remove(fd);
+	close(fd);
+}
+#endif
+
+bool runServer(const ModelIndex &index, const char *socketPath)
+{
+#ifdef _WIN32
+	(void)index;
+	(void)socketPath;
+
+	std::cout << "ERROR: serve mode is only supported on Unix-like systems." << std::endl;
+	return false;
+#else
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+
+	if (strlen(socketPath) >= sizeof(addr.sun_path))
+	{
+		std::cout << "ERROR: socket path is too long: " << socketPath << std::endl;
+		return false;
+	}
+
+	strcpy(addr.sun_path, socketPath);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0)
+	{
+		std::cout << "ERROR: failed to create socket: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// A clean shutdown can't remove the socket file, so replace any stale one
+	unlink(socketPath);
+
+	if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, SOMAXCONN) < 0)
+	{
+		std::cout << "ERROR: failed to listen on " << socketPath << ": " << strerror(errno) << std::endl;
+		close(listener);
+		return false;
+	}
+
+	// Clients that disconnect mid-response shouldn't take the server down
+	signal(SIGPIPE, SIG_IGN);
+
+	std::cout << "Listening on " << socketPath << "..." << std::endl;
+
+	ClientSet clients;
+	ThreadPool pool(MAX_CLIENTS);
+
+	while (true)
+	{
+		int client = accept(listener, nullptr, nullptr);
+
+		if (client < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			std::cout << "ERROR: accept failed: " << strerror(errno) << std::endl;
+			break;
+		}
+
+		pool.submit([&index, &clients, client] { serveClient(index, clients, client); });
+	}
+
+	// Every client is done with the index before the caller can free it
+	clients.stop();
+	pool.wait();
+
+	close(listener);
+	unlink(socketPath);
+
+	return false;
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "model_index.h"
+
+// Listens on a Unix domain socket at `socketPath` and answers ModelIndex
+// queries, one request per line, until the process is stopped. Up to 16
+// clients are served at once, each on a worker thread; the index is shared and
+// only read. Returns false if the socket could not be set up or accepting
+// failed, after every client has been disconnected.
+bool runServer(const ModelIndex &index, const char *socketPath);
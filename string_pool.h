@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Keeps one copy of every distinct string. Interned strings are compared by
+// pointer and stay valid until the pool is cleared. Characters are stored in
+// large blocks and the lookup table is open addressing, so interning a string
+// that is already in the pool allocates nothing.
+class StringPool
+{
+public:
+	StringPool()
+	{
+		clear();
+	}
+
+	const char* intern(const char *str, size_t length)
+	{
+		uint64_t hash = hashString(str, length);
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask)
+		{
+			Slot &slot = m_slots[i];
+
+			if (!slot.str)
+			{
+				const char *copy = store(str, length);
+
+				slot.str = copy;
+				slot.length = length;
+				slot.hash = hash;
+
+				if (++m_count * 4 > m_slots.size() * 3)
+					grow();
+
+				return copy;
+			}
+
+			if (slot.hash == hash && slot.length == length && memcmp(slot.str, str, length) == 0)
+				return slot.str;
+		}
+	}
+
+	const char* intern(std::string_view str)
+	{
+		return intern(str.data(), str.size());
+	}
+
+	void clear()
+	{
+		m_slots.assign(1024, Slot());
+		m_blocks.clear();
+		m_blockUsed = m_blockSize = 0;
+		m_count = 0;
+	}
+
+	static uint64_t hashString(const char *str, size_t length)
+	{
+		// 64-bit FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= (unsigned char)str[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+private:
+	struct Slot
+	{
+		const char *str = nullptr;
+		size_t length = 0;
+		uint64_t hash = 0;
+	};
+
+	std::vector<Slot> m_slots; // Size is a power of two
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	size_t m_blockUsed;
+	size_t m_blockSize;
+	size_t m_count;
+
+	// Copies a string, with a terminating null, into the current block
+	const char* store(const char *str, size_t length)
+	{
+		const size_t minBlockSize = 64 * 1024;
+
+		if (m_blockUsed + length + 1 > m_blockSize)
+		{
+			m_blockSize = std::max(minBlockSize, length + 1);
+			m_blocks.emplace_back(new char[m_blockSize]);
+			m_blockUsed = 0;
+		}
+
+		char *copy = m_blocks.back().get() + m_blockUsed;
+
+		memcpy(copy, str, length);
+		copy[length] = '\0';
+		m_blockUsed += length + 1;
+
+		return copy;
+	}
+
+	void grow()
+	{
+		std::vector<Slot> old;
+		old.swap(m_slots);
+		m_slots.assign(old.size() * 2, Slot());
+
+		size_t mask = m_slots.size() - 1;
+
+		for (Slot &slot : old)
+		{
+			if (!slot.str)
+				continue;
+
+			size_t i = (size_t)slot.hash & mask;
+
+			while (m_slots[i].str)
+				i = (i + 1) & mask;
+
+			m_slots[i] = slot;
+		}
+	}
+};
+
+// Counts occurrences of interned strings, keyed by pointer. reset() forgets
+// every count in O(1) by bumping a generation number instead of clearing
+// the table.
+class InternedCounter
+{
+public:
+	InternedCounter()
+	{
+		m_slots.assign(1024, Slot());
+		m_generation = 1;
+		m_count = 0;
+	}
+
+	// Adds one to the count of `key` and returns the count before that
+	int increment(const char *key)
+	{
+		Slot *slot = findSlot(key);
+
+		if (slot->generation != m_generation)
+		{
+			slot->key = key;
+			slot->generation = m_generation;
+			slot->count = 0;
+
+			if (++m_count * 4 > m_slots.size() * 3)
+			{
+				grow();
+				slot = findSlot(key);
+			}
+		}
+
+		return slot->count++;
+	}
+
+	int get(const char *key) const
+	{
+		const Slot *slot = const_cast<InternedCounter*>(this)->findSlot(key);
+		return (slot->generation == m_generation) ? slot->count : 0;
+	}
+
+	void reset()
+	{
+		m_generation++;
+		m_count = 0;
+	}
+
+private:
+	struct Slot
+	{
+		const char *key = nullptr;
+		unsigned generation = 0;
+		int count = 0;
+	};
+
+	std::vector<Slot> m_slots; // Size is a power of two
+	unsigned m_generation;
+	size_t m_count;
+
+	static size_t hashPointer(const char *key)
+	{
+		uint64_t x = (uint64_t)(uintptr_t)key;
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		return (size_t)x;
+	}
+
+	// The slot holding `key` in the current generation, or the empty slot where it would go
+	Slot* findSlot(const char *key)
+	{
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t i = hashPointer(key) & mask;; i = (i + 1) & mask)
+		{
+			Slot &slot = m_slots[i];
+
+			if (slot.generation != m_generation || slot.key == key)
+				return &slot;
+		}
+	}
+
+	void grow()
+	{
+		std::vector<Slot> old;
+		old.swap(m_slots);
+		m_slots.assign(old.size() * 2, Slot());
+
+		size_t mask = m_slots.size() - 1;
+
+		for (Slot &slot : old)
+		{
+			if (slot.generation != m_generation)
+				continue;
+
+			size_t i = hashPointer(slot.key) & mask;
+
+			while (m_slots[i].generation == m_generation)
+				i = (i + 1) & mask;
+
+			m_slots[i] = slot;
+		}
+	}
+};
@@ -1,159 +1,196 @@
 #pragma once
 
 #include "elf.h"
-#include <map>
+#include "bulk_decode.h"
+#include <algorithm>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct SymbolInfo
 {
-	std::string name;
+	const char* name;
 	Elf32_Addr address;
 	Elf32_Word size;
 	bool is_function;
 	bool is_global;
-	
-	SymbolInfo() : address(0), size(0), is_function(false), is_global(false) {}
-	
-	SymbolInfo(const std::string& n, Elf32_Addr addr, Elf32_Word sz, bool func, bool global)
+
+	SymbolInfo() : name(""), address(0), size(0), is_function(false), is_global(false) {}
+
+	SymbolInfo(const char* n, Elf32_Addr addr, Elf32_Word sz, bool func, bool global)
 		: name(n), address(addr), size(sz), is_function(func), is_global(global) {}
 };
 
 class SymbolTable
 {
 private:
-	std::map<Elf32_Addr, SymbolInfo> address_to_symbol;
-	std::map<std::string, SymbolInfo> name_to_symbol;
+	// Raw .symtab contents, decoded in bulk into one column per field
+	std::vector<Elf32_Word> name_column;
+	std::vector<Elf32_Addr> value_column;
+	std::vector<Elf32_Word> size_column;
+	std::vector<unsigned char> info_column;
+	std::vector<Elf32_Half> shndx_column;
+
+	// Functions and global variables, sorted by address and by name.
+	// When several symbols share a key, the last one in the table wins.
+	std::vector<SymbolInfo> by_address;
+	std::vector<SymbolInfo> by_name;
 	bool loaded;
 
+	// Sorts `symbols` by `less` and keeps only the last symbol of each run of equal keys
+	template<class Less>
+	static void sortUnique(std::vector<SymbolInfo>& symbols, Less less)
+	{
+		std::stable_sort(symbols.begin(), symbols.end(), less);
+
+		size_t out = 0;
+
+		for (size_t i = 0; i < symbols.size(); i++)
+		{
+			if (i + 1 < symbols.size() && !less(symbols[i], symbols[i + 1]))
+				continue;
+
+			symbols[out++] = symbols[i];
+		}
+
+		symbols.resize(out);
+	}
+
 public:
 	SymbolTable() : loaded(false) {}
-	
-	bool loadFromElf(ElfFile* elf)
+
+	// Progress messages go to `log`, if there is one
+	bool loadFromElf(ElfFile* elf, std::ostream* log = nullptr)
 	{
 		if (!elf) return false;
-		
+
 		int symbol_count = 0;
-		Elf32_Sym* symbols = elf->getSymbolTable(&symbol_count);
-		
+		const Elf32_Sym* symbols = elf->getSymbolTable(&symbol_count);
+
 		if (!symbols || symbol_count == 0) {
 			return false;
 		}
-		
-		printf("Loading %d symbols from ELF symbol table...\n", symbol_count);
-		
+
+		if (log)
+			*log << "Loading " << symbol_count << " symbols from ELF symbol table..." << std::endl;
+
+		name_column.resize(symbol_count);
+		value_column.resize(symbol_count);
+		size_column.resize(symbol_count);
+		info_column.resize(symbol_count);
+		shndx_column.resize(symbol_count);
+
+		BulkDecode::SymbolColumns columns;
+		columns.name = name_column.data();
+		columns.value = value_column.data();
+		columns.size = size_column.data();
+		columns.info = info_column.data();
+		columns.shndx = shndx_column.data();
+
+		BulkDecode::decodeSymbols(symbols, symbol_count, elf->shouldReverseEndian(), columns);
+
+		const char* strtab = elf->getStringTable();
+
 		int functions_loaded = 0;
 		int variables_loaded = 0;
-		
+
 		for (int i = 0; i < symbol_count; i++) {
-			Elf32_Sym* sym = &symbols[i];
-			
-			// Read symbol properties
-			Elf32_Addr address = elf->read<Elf32_Addr>((void*)&sym->st_value);
-			Elf32_Word size = elf->read<Elf32_Word>((void*)&sym->st_size);
-			unsigned char info = sym->st_info;
-			
+			Elf32_Addr address = value_column[i];
+			unsigned char info = info_column[i];
+
 			// Skip symbols without addresses or names
-			if (address == 0) continue;
-			
-			const char* symbol_name = elf->getSymbolName(sym);
-			if (!symbol_name || strlen(symbol_name) == 0) continue;
-			
+			if (address == 0 || !strtab || name_column[i] == 0) continue;
+
+			const char* symbol_name = strtab + name_column[i];
+			if (symbol_name[0] == '\0') continue;
+
 			// Determine symbol type
 			unsigned char type = ELF32_ST_TYPE(info);
 			unsigned char bind = ELF32_ST_BIND(info);
-			
+
 			bool is_function = (type == STT_FUNC);
 			bool is_variable = (type == STT_OBJECT);
 			bool is_global = (bind == STB_GLOBAL) || (bind == STB_WEAK);
-			
+
 			// Only store functions and global variables
 			if (is_function || (is_variable && is_global)) {
-				SymbolInfo symbol_info(symbol_name, address, size, is_function, is_global);
-				
-				address_to_symbol[address] = symbol_info;
-				name_to_symbol[symbol_name] = symbol_info;
-				
+				by_address.push_back(SymbolInfo(symbol_name, address, size_column[i], is_function, is_global));
+
 				if (is_function) functions_loaded++;
 				else variables_loaded++;
 			}
 		}
-		
-		printf("Loaded %d functions and %d variables from symbol table\n", 
-			   functions_loaded, variables_loaded);
-		
+
+		by_name = by_address;
+
+		sortUnique(by_address, [](const SymbolInfo& a, const SymbolInfo& b) { return a.address < b.address; });
+		sortUnique(by_name, [](const SymbolInfo& a, const SymbolInfo& b) { return strcmp(a.name, b.name) < 0; });
+
+		if (log)
+			*log << "Loaded " << functions_loaded << " functions and " << variables_loaded << " variables from symbol table" << std::endl;
+
 		loaded = true;
 		return true;
 	}
-	
+
 	// Find symbol by address
 	const SymbolInfo* findByAddress(Elf32_Addr address) const
 	{
 		if (!loaded) return nullptr;
-		
-		auto it = address_to_symbol.find(address);
-		if (it != address_to_symbol.end()) {
-			return &it->second;
+
+		auto it = std::lower_bound(by_address.begin(), by_address.end(), address,
+			[](const SymbolInfo& s, Elf32_Addr a) { return s.address < a; });
+		if (it != by_address.end() && it->address == address) {
+			return &*it;
 		}
-		
+
 		return nullptr;
 	}
-	
+
 	// Find symbol by name
-	const SymbolInfo* findByName(const std::string& name) const
+	const SymbolInfo* findByName(std::string_view name) const
 	{
 		if (!loaded) return nullptr;
-		
-		auto it = name_to_symbol.find(name);
-		if (it != name_to_symbol.end()) {
-			return &it->second;
+
+		auto it = std::lower_bound(by_name.begin(), by_name.end(), name,
+			[](const SymbolInfo& s, std::string_view n) { return n.compare(s.name) > 0; });
+		if (it != by_name.end() && name.compare(it->name) == 0) {
+			return &*it;
 		}
-		
+
 		return nullptr;
 	}
-	
+
 	// Find function containing an address (for addresses within function ranges)
 	const SymbolInfo* findFunctionContaining(Elf32_Addr address) const
 	{
 		if (!loaded) return nullptr;
-		
-		const SymbolInfo* best_match = nullptr;
-		Elf32_Addr best_distance = 0xFFFFFFFF;
-		
-		for (const auto& pair : address_to_symbol) {
-			const SymbolInfo& symbol = pair.second;
-			
-			if (symbol.is_function && symbol.address <= address) {
-				Elf32_Addr distance = address - symbol.address;
-				
-				// Check if address falls within function range (if size is known)
-				if (symbol.size > 0) {
-					if (distance < symbol.size && distance < best_distance) {
-						best_match = &symbol;
-						best_distance = distance;
-					}
-				} else {
-					// If size is unknown, find closest function before this address
-					if (distance < best_distance) {
-						best_match = &symbol;
-						best_distance = distance;
-					}
-				}
-			}
+
+		// Walk down from the closest symbol at or below the address; the first
+		// function that covers it (or has no known size) is the nearest match
+		auto it = std::upper_bound(by_address.begin(), by_address.end(), address,
+			[](Elf32_Addr a, const SymbolInfo& s) { return a < s.address; });
+
+		while (it != by_address.begin()) {
+			const SymbolInfo& symbol = *--it;
+
+			if (!symbol.is_function)
+				continue;
+
+			// Check if address falls within function range (if size is known)
+			if (symbol.size == 0 || address - symbol.address < symbol.size)
+				return &symbol;
 		}
-		
-		return best_match;
+
+		return nullptr;
 	}
-	
+
 	// Get all symbols for debugging
 	std::vector<SymbolInfo> getAllSymbols() const
 	{
-		std::vector<SymbolInfo> result;
-		for (const auto& pair : address_to_symbol) {
-			result.push_back(pair.second);
-		}
-		return result;
+		return by_address;
 	}
-	
+
 	bool isLoaded() const { return loaded; }
-};
\ No newline at end of file
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "buffered_output.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+// Writes files into an uncompressed POSIX (ustar) tar archive. Everything goes
+// through one large buffer and is written out sequentially, so an archive of
+// thousands of files costs a handful of write calls. Paths that don't fit the
+// ustar header get a pax extended header.
+class TarWriter
+{
+public:
+	// filename "-" writes to stdout
+	TarWriter(const char *filename) : m_output(filename)
+	{
+		m_mtime = (unsigned long long)time(nullptr);
+		m_closed = false;
+	}
+
+	~TarWriter()
+	{
+		close();
+	}
+
+	TarWriter(const TarWriter&) = delete;
+	TarWriter& operator=(const TarWriter&) = delete;
+
+	// `path` is relative and uses '/' as the separator
+	void addFile(const std::string &path, const std::string &contents)
+	{
+		if (m_output.hasError())
+			return;
+
+		std::string name = path;
+		std::string prefix;
+
+		if (!splitPath(path, &prefix, &name))
+		{
+			// "<length> path=<path>\n", where the length counts itself
+			std::string record = " path=" + path + "\n";
+			size_t length = record.size() + 1;
+
+			while (std::to_string(length).size() + record.size() != length)
+				length++;
+
+			record = std::to_string(length) + record;
+
+			addHeader("PaxHeader", "", 'x', record.size());
+			addData(record.data(), record.size());
+
+			// Old tar programs see a truncated name instead
+			name = path.substr(path.size() - NAME_SIZE);
+			prefix.clear();
+		}
+
+		addHeader(name, prefix, '0', contents.size());
+		addData(contents.data(), contents.size());
+	}
+
+	// Writes the end-of-archive marker and flushes. Returns false if anything
+	// couldn't be written.
+	bool close()
+	{
+		if (!m_closed && !m_output.hasError())
+			m_output.fill('\0', BLOCK_SIZE * 2);
+
+		m_closed = true;
+		return m_output.close();
+	}
+
+	bool hasError() const
+	{
+		return m_output.hasError();
+	}
+
+private:
+	static constexpr size_t BLOCK_SIZE = 512;
+	static constexpr size_t NAME_SIZE = 100;
+	static constexpr size_t PREFIX_SIZE = 155;
+
+	BufferedOutput m_output;
+	unsigned long long m_mtime;
+	bool m_closed;
+
+	// Splits a path into the ustar name and prefix fields at a '/'. Returns
+	// false if the path is too long for them.
+	static bool splitPath(const std::string &path, std::string *prefix, std::string *name)
+	{
+		if (path.size() <= NAME_SIZE)
+		{
+			prefix->clear();
+			*name = path;
+			return true;
+		}
+
+		for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+		{
+			if (slash <= PREFIX_SIZE && path.size() - slash - 1 <= NAME_SIZE && slash + 1 < path.size())
+			{
+				*prefix = path.substr(0, slash);
+				*name = path.substr(slash + 1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void putOctal(char *field, size_t size, unsigned long long value)
+	{
+		// size - 1 digits followed by a null
+		snprintf(field, size, "%0*llo", (int)(size - 1), value);
+	}
+
+	void addHeader(const std::string &name, const std::string &prefix, char type, size_t size)
+	{
+		char header[BLOCK_SIZE];
+		memset(header, 0, sizeof(header));
+
+		memcpy(header, name.data(), std::min(name.size(), NAME_SIZE));
+		putOctal(header + 100, 8, 0644);   // mode
+		putOctal(header + 108, 8, 0);      // uid
+		putOctal(header + 116, 8, 0);      // gid
+		putOctal(header + 124, 12, size);  // size
+		putOctal(header + 136, 12, m_mtime);
+		header[156] = type;
+		memcpy(header + 257, "ustar", 6);  // magic, null-terminated
+		memcpy(header + 263, "00", 2);     // version
+		memcpy(header + 345, prefix.data(), std::min(prefix.size(), PREFIX_SIZE));
+
+		// The checksum is computed with the checksum field set to spaces
+		memset(header + 148, ' ', 8);
+
+		unsigned checksum = 0;
+
+		for (size_t i = 0; i < sizeof(header); i++)
+			checksum += (unsigned char)header[i];
+
+		snprintf(header + 148, 8, "%06o", checksum);
+		header[155] = ' ';
+
+		addData(header, sizeof(header));
+	}
+
+	// Appends data padded to a whole number of blocks
+	void addData(const char *data, size_t size)
+	{
+		m_output.write(data, size);
+		m_output.fill('\0', (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE);
+	}
+};
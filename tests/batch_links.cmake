@@ -0,0 +1,33 @@
+# Writes the same ELF file to two directories in batch mode, which hard links
+# the second set of files to the first, then converts a changed ELF file into
+# the first directory. The second one must keep its contents.
+#
+# cmake -DDWARF2CPP=<dwarf2cpp> -DELF=<ELF file> -DCHANGED_ELF=<ELF file> -P batch_links.cmake
+
+file(REMOVE_RECURSE links_a links_b)
+file(WRITE links.txt "${ELF} links_a\n${ELF} links_b\n")
+
+execute_process(COMMAND ${DWARF2CPP} batch links.txt OUTPUT_QUIET RESULT_VARIABLE result)
+
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Batch conversion failed")
+endif()
+
+file(READ links_b/game.cpp before)
+
+execute_process(COMMAND ${DWARF2CPP} ${CHANGED_ELF} links_a OUTPUT_QUIET RESULT_VARIABLE result)
+
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Conversion of ${CHANGED_ELF} failed")
+endif()
+
+file(READ links_a/game.cpp changed)
+file(READ links_b/game.cpp after)
+
+if(changed STREQUAL before)
+    message(FATAL_ERROR "${CHANGED_ELF} converts to the same files as ${ELF}")
+endif()
+
+if(NOT after STREQUAL before)
+    message(FATAL_ERROR "Writing links_a/game.cpp changed the file linked to it")
+endif()
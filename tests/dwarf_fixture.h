@@ -0,0 +1,325 @@
+#pragma once
+
+#include "dwarf.h"
+#include "elf.h"
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Builds small little-endian ELF files with a DWARF1 .debug section for the
+// tests. Entries are created as a tree; their DW_AT_sibling attributes and the
+// null entries that end each list of children are written automatically.
+namespace Fixture
+{
+struct Entry;
+
+// Part of a block attribute: raw bytes, or the offset of an entry
+struct Piece
+{
+	std::string bytes;
+	Entry *ref = nullptr;
+};
+
+struct Attribute
+{
+	Elf32_Half name;
+	Elf32_Word value = 0;       // DW_FORM_ADDR, DW_FORM_DATA2 and DW_FORM_DATA4
+	std::string string;         // DW_FORM_STRING
+	Entry *ref = nullptr;       // DW_FORM_REF
+	std::vector<Piece> block;   // DW_FORM_BLOCK2 and DW_FORM_BLOCK4
+};
+
+struct Entry
+{
+	Elf32_Half tag;
+	std::vector<Attribute> attributes;
+	std::vector<Entry*> children;
+	Elf32_Off offset = 0;
+
+	Entry& attr(Elf32_Half name, Elf32_Word value)
+	{
+		Attribute a;
+		a.name = name;
+		a.value = value;
+		attributes.push_back(a);
+		return *this;
+	}
+
+	Entry& attr(Elf32_Half name, const char *string)
+	{
+		Attribute a;
+		a.name = name;
+		a.string = string;
+		attributes.push_back(a);
+		return *this;
+	}
+
+	Entry& ref(Elf32_Half name, Entry *target)
+	{
+		Attribute a;
+		a.name = name;
+		a.ref = target;
+		attributes.push_back(a);
+		return *this;
+	}
+
+	Entry& block(Elf32_Half name, std::vector<Piece> pieces)
+	{
+		Attribute a;
+		a.name = name;
+		a.block = std::move(pieces);
+		attributes.push_back(a);
+		return *this;
+	}
+
+	Entry& name(const char *name)
+	{
+		return attr(DW_AT_name, name);
+	}
+
+	// DW_AT_user_def_type, or DW_AT_mod_u_d_type for a pointer
+	Entry& type(Entry *userType, bool pointer = false)
+	{
+		if (!pointer)
+			return ref(DW_AT_user_def_type, userType);
+
+		Piece modifier;
+		modifier.bytes = std::string(1, (char)DW_MOD_pointer_to);
+
+		Piece target;
+		target.ref = userType;
+
+		return block(DW_AT_mod_u_d_type, { modifier, target });
+	}
+
+	Entry& fundType(Elf32_Half fundamentalType)
+	{
+		return attr(DW_AT_fund_type, fundamentalType);
+	}
+
+	Entry& location(Elf32_Word address)
+	{
+		Piece op;
+		op.bytes = std::string(1, (char)DW_OP_ADDR) + std::string((const char*)&address, sizeof(address));
+		return block(DW_AT_location, { op });
+	}
+};
+
+class Builder
+{
+public:
+	Entry* compileUnit(const char *filename)
+	{
+		Entry *cu = create(nullptr, DW_TAG_compile_unit);
+		cu->name(filename);
+		m_units.push_back(cu);
+		return cu;
+	}
+
+	Entry* add(Entry *parent, Elf32_Half tag)
+	{
+		return create(parent, tag);
+	}
+
+	Entry* structType(Entry *parent, const char *name, Elf32_Word size, Elf32_Half tag = DW_TAG_structure_type)
+	{
+		Entry *s = create(parent, tag);
+		s->name(name).attr(DW_AT_byte_size, size);
+		return s;
+	}
+
+	Entry* member(Entry *parent, const char *name, Elf32_Half fundamentalType, Elf32_Word offset)
+	{
+		Piece op;
+		op.bytes = std::string(1, (char)DW_OP_CONST) + std::string((const char*)&offset, sizeof(offset));
+
+		Entry *m = create(parent, DW_TAG_member);
+		m->name(name).fundType(fundamentalType).block(DW_AT_location, { op });
+		return m;
+	}
+
+	Entry* variable(Entry *parent, const char *name, Entry *userType, Elf32_Word address)
+	{
+		Entry *v = create(parent, DW_TAG_global_variable);
+		v->name(name).type(userType).location(address);
+		return v;
+	}
+
+	// A function with a "this" parameter pointing at `owner` if there is one
+	Entry* function(Entry *parent, const char *name, const char *mangledName, Elf32_Addr address, Entry *owner = nullptr)
+	{
+		Entry *f = create(parent, DW_TAG_global_subroutine);
+		f->name(name).attr(DW_AT_mangled_name, mangledName).attr(DW_AT_low_pc, address).attr(DW_AT_high_pc, address + 0x10).fundType(DW_FT_void);
+
+		if (owner)
+			create(f, DW_TAG_formal_parameter)->name("this").type(owner, true);
+
+		return f;
+	}
+
+	// Lays out the entries and returns the section contents
+	std::string debugSection()
+	{
+		// Offsets are only known after the first pass
+		std::string data;
+		layout(m_units, data);
+		data.clear();
+		layout(m_units, data);
+		return data;
+	}
+
+	// Writes an ELF file holding only the .debug section
+	bool write(const std::string &path)
+	{
+		std::string debug = debugSection();
+		std::string names = std::string("\0.debug\0.shstrtab\0", 18);
+
+		Elf32_Ehdr header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.e_ident, "\x7f" "ELF", 4);
+		header.e_ident[EI_CLASS] = ELFCLASS32;
+		header.e_ident[EI_DATA] = 1; // Little endian
+		header.e_ident[EI_VERSION] = 1;
+		header.e_type = 2;
+		header.e_machine = EM_MIPS;
+		header.e_version = 1;
+		header.e_ehsize = sizeof(Elf32_Ehdr);
+		header.e_shentsize = sizeof(Elf32_Shdr);
+		header.e_shnum = 3;
+		header.e_shstrndx = 2;
+
+		Elf32_Off debugOffset = sizeof(Elf32_Ehdr);
+		Elf32_Off namesOffset = debugOffset + debug.size();
+		header.e_shoff = (namesOffset + names.size() + 3) & ~3u;
+
+		Elf32_Shdr sections[3];
+		memset(sections, 0, sizeof(sections));
+		sections[1].sh_name = 1;
+		sections[1].sh_type = 0x70000005;
+		sections[1].sh_offset = debugOffset;
+		sections[1].sh_size = debug.size();
+		sections[2].sh_name = 8;
+		sections[2].sh_type = 3;
+		sections[2].sh_offset = namesOffset;
+		sections[2].sh_size = names.size();
+
+		std::string file((const char*)&header, sizeof(header));
+		file += debug;
+		file += names;
+		file.resize(header.e_shoff, '\0');
+		file.append((const char*)sections, sizeof(sections));
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << file;
+		out.close();
+		return (bool)out;
+	}
+
+private:
+	std::deque<Entry> m_entries;
+	std::vector<Entry*> m_units;
+
+	Entry* create(Entry *parent, Elf32_Half tag)
+	{
+		m_entries.emplace_back();
+		m_entries.back().tag = tag;
+
+		if (parent)
+			parent->children.push_back(&m_entries.back());
+
+		return &m_entries.back();
+	}
+
+	template<class T>
+	static void append(std::string &data, T value)
+	{
+		data.append((const char*)&value, sizeof(value));
+	}
+
+	static void appendAttribute(std::string &data, const Attribute &a)
+	{
+		append<Elf32_Half>(data, a.name);
+
+		switch (a.name & 0xf)
+		{
+		case DW_FORM_ADDR:
+		case DW_FORM_DATA4:
+			append<Elf32_Word>(data, a.value);
+			break;
+		case DW_FORM_DATA2:
+			append<Elf32_Half>(data, (Elf32_Half)a.value);
+			break;
+		case DW_FORM_REF:
+			append<Elf32_Off>(data, a.ref->offset);
+			break;
+		case DW_FORM_STRING:
+			data += a.string;
+			data += '\0';
+			break;
+		case DW_FORM_BLOCK2:
+		case DW_FORM_BLOCK4:
+		{
+			std::string block;
+
+			for (const Piece &p : a.block)
+			{
+				if (p.ref)
+					append<Elf32_Off>(block, p.ref->offset);
+				else
+					block += p.bytes;
+			}
+
+			if ((a.name & 0xf) == DW_FORM_BLOCK2)
+				append<Elf32_Half>(data, (Elf32_Half)block.size());
+			else
+				append<Elf32_Word>(data, (Elf32_Word)block.size());
+
+			data += block;
+			break;
+		}
+		}
+	}
+
+	// Writes a list of siblings followed by the null entry ending it. Every
+	// entry's DW_AT_sibling points at the next one, or at the null entry.
+	// Returns the null entry's offset.
+	Elf32_Off layout(const std::vector<Entry*> &entries, std::string &data)
+	{
+		std::vector<Elf32_Off> siblingPositions;
+
+		for (Entry *e : entries)
+		{
+			e->offset = data.size();
+
+			std::string body;
+			append<Elf32_Half>(body, e->tag);
+			append<Elf32_Half>(body, DW_AT_sibling);
+			siblingPositions.push_back(e->offset + sizeof(Elf32_Word) + body.size());
+			append<Elf32_Off>(body, 0);
+
+			for (const Attribute &a : e->attributes)
+				appendAttribute(body, a);
+
+			append<Elf32_Word>(data, sizeof(Elf32_Word) + body.size());
+			data += body;
+
+			if (!e->children.empty())
+				layout(e->children, data);
+		}
+
+		Elf32_Off end = data.size();
+		append<Elf32_Word>(data, sizeof(Elf32_Word));
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			Elf32_Off sibling = (i + 1 < entries.size()) ? entries[i + 1]->offset : end;
+			memcpy(&data[siblingPositions[i]], &sibling, sizeof(sibling));
+		}
+
+		return end;
+	}
+};
+}
@@ -0,0 +1,470 @@
+#include "bulk_decode.h"
+#include "demangle.h"
+#include "dwarf2cpp.h"
+#include "dwarf_fixture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Conversion tests on small generated ELF files. Every test runs and the exit
+// code is the number of failed checks. The fixtures are written to the
+// working directory.
+
+static int g_numFailed = 0;
+
+static bool check(bool condition, const char *expression, const char *file, int line)
+{
+	if (!condition)
+	{
+		std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+		g_numFailed++;
+	}
+
+	return condition;
+}
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+// Writes the fixture and loads it into the context, printing any errors
+static bool load(Dwarf2Cpp &context, Fixture::Builder &builder, const char *name)
+{
+	std::string path = std::string(name) + ".elf";
+
+	if (!CHECK(builder.write(path)))
+		return false;
+
+	bool loaded = context.load(path);
+
+	for (const Dwarf2Cpp::Error &error : context.getErrors())
+		std::cerr << "\t" << path << ": " << error.message << std::endl;
+
+	return loaded;
+}
+
+static Cpp::UserType* findType(const Dwarf2Cpp &context, const char *name, size_t index = 0)
+{
+	for (auto &pair : context.getUserTypes())
+	{
+		if (pair.second->name == name && index-- == 0)
+			return pair.second;
+	}
+
+	return nullptr;
+}
+
+// A member function whose "this" points at a class of a later compile unit
+static void testForwardThisReference()
+{
+	Fixture::Builder builder;
+	Fixture::Entry *first = builder.compileUnit("first.cpp");
+	Fixture::Entry *second = builder.compileUnit("second.cpp");
+
+	Fixture::Entry *scene = builder.structType(second, "zScene", 4, DW_TAG_class_type);
+	builder.member(scene, "id", DW_FT_integer, 0);
+	builder.function(first, "Update", "Update__6zSceneFv", 0x1000, scene);
+
+	Dwarf2Cpp context;
+
+	if (!CHECK(load(context, builder, "forward_this")))
+		return;
+
+	Cpp::UserType *type = findType(context, "zScene");
+
+	if (CHECK(type && type->classData))
+		CHECK(type->classData->functions.size() == 1 && type->classData->functions[0].name == "Update");
+}
+
+// Compile units that each define class zScene with a static and a non-static
+// member function, like a game built from many files including the same header
+static void buildManyUnits(Fixture::Builder &builder)
+{
+	for (int i = 0; i < 64; i++)
+	{
+		std::string filename = "unit" + std::to_string(i) + ".cpp";
+		std::string variable = "gScene" + std::to_string(i);
+		Elf32_Addr address = 0x1000 + i * 0x100;
+
+		Fixture::Entry *cu = builder.compileUnit(filename.c_str());
+		Fixture::Entry *scene = builder.structType(cu, "zScene", 4, DW_TAG_class_type);
+		builder.member(scene, "id", DW_FT_integer, 0);
+		builder.variable(cu, variable.c_str(), scene, 0x80000 + i * 4);
+		builder.function(cu, "Render", "Render__6zSceneFPv", address);
+		builder.function(cu, "Update", "Update__6zSceneFv", address + 0x80, scene);
+	}
+}
+
+// Static member functions go to the class of their own compile unit, once
+static void testStaticMethodOwner()
+{
+	Fixture::Builder builder;
+	buildManyUnits(builder);
+
+	Dwarf2Cpp context;
+
+	if (!CHECK(load(context, builder, "many_units")))
+		return;
+
+	for (size_t i = 0; i < 64; i++)
+	{
+		Cpp::UserType *type = findType(context, "zScene", i);
+
+		if (!CHECK(type && type->classData))
+			return;
+
+		std::vector<Cpp::Function> &functions = type->classData->functions;
+		CHECK(functions.size() == 2);
+		CHECK(std::count_if(functions.begin(), functions.end(), [](const Cpp::Function &f) { return f.name == "Render"; }) == 1);
+	}
+}
+
+// Variables whose types are defined in an earlier and in a later compile unit
+static void buildCrossUnit(Fixture::Builder &builder, const char *sceneVariable = "gScene1")
+{
+	Fixture::Entry *scene = builder.compileUnit("scene.cpp");
+	Fixture::Entry *game = builder.compileUnit("game.cpp");
+	Fixture::Entry *player = builder.compileUnit("player.cpp");
+
+	Fixture::Entry *sceneType = builder.structType(scene, "zScene", 4);
+	builder.member(sceneType, "id", DW_FT_integer, 0);
+
+	Fixture::Entry *playerType = builder.structType(player, "xPlayer", 8);
+	builder.member(playerType, "health", DW_FT_integer, 0);
+	builder.member(playerType, "lives", DW_FT_integer, 4);
+
+	builder.variable(game, sceneVariable, sceneType, 0x80000);
+	builder.variable(game, "gPlayer", playerType, 0x80004);
+}
+
+static void testCrossUnitReference()
+{
+	Fixture::Builder builder;
+	buildCrossUnit(builder);
+
+	Dwarf2Cpp context;
+
+	if (!CHECK(load(context, builder, "cross_unit")))
+		return;
+
+	CHECK(context.getFiles().size() == 3);
+
+	for (Cpp::File *cpp : context.getFiles())
+	{
+		if (cpp->filename != "game.cpp" || !CHECK(cpp->variables.size() == 2))
+			continue;
+
+		CHECK(cpp->variables[0].type.userType == findType(context, "zScene"));
+		CHECK(cpp->variables[1].type.userType == findType(context, "xPlayer"));
+		CHECK(cpp->variables[1].type.size() == 8);
+	}
+}
+
+// Types of compile units the filter skips are still found
+static void testSkippedUnitReference()
+{
+	Fixture::Builder builder;
+	buildCrossUnit(builder);
+
+	Converter::Options options;
+	options.filter.compileUnits.push_back("game.cpp");
+
+	Dwarf2Cpp context(options);
+
+	if (!CHECK(load(context, builder, "skipped_unit")))
+		return;
+
+	if (!CHECK(context.getFiles().size() == 1))
+		return;
+
+	Cpp::File *cpp = context.getFiles()[0];
+
+	if (!CHECK(cpp->variables.size() == 2))
+		return;
+
+	Cpp::UserType *scene = cpp->variables[0].type.userType;
+	Cpp::UserType *player = cpp->variables[1].type.userType;
+
+	CHECK(scene && scene->getName() == "zScene" && scene->classData && scene->classData->members.size() == 1);
+	CHECK(player && player->getName() == "xPlayer" && cpp->variables[1].type.size() == 8);
+}
+
+// stream() hands out the same files as load(), while keeping few units in memory
+static void testStream()
+{
+	Fixture::Builder builders[2];
+	buildManyUnits(builders[0]);
+	buildCrossUnit(builders[1]);
+
+	const char *names[2] = { "stream_many_units", "stream_cross_unit" };
+
+	for (int i = 0; i < 2; i++)
+	{
+		Dwarf2Cpp context;
+
+		if (!CHECK(load(context, builders[i], names[i])))
+			continue;
+
+		std::vector<std::string> loaded;
+
+		for (Cpp::File *cpp : context.getFiles())
+			loaded.push_back(cpp->toString(false, true));
+
+		std::vector<std::string> streamed;
+		Dwarf2Cpp::StreamStats stats;
+
+		bool success = context.stream(std::string(names[i]) + ".elf", [&streamed](Cpp::File *cpp) {
+			streamed.push_back(cpp->toString(false, true));
+		}, &stats);
+
+		CHECK(success && context.getErrors().empty());
+		CHECK(streamed == loaded);
+		CHECK(stats.numFiles == loaded.size());
+		CHECK(stats.maxResidentUnits >= 1 && stats.maxResidentUnits <= 8);
+		CHECK(context.getFiles().empty() && context.getDwarf());
+	}
+}
+
+// Reads a value of `size` bytes in the byte order of the file
+static uint32_t readBytes(const unsigned char *p, size_t size, bool bigEndian)
+{
+	uint32_t x = 0;
+
+	for (size_t i = 0; i < size; i++)
+		x |= (uint32_t)p[bigEndian ? i : size - 1 - i] << (8 * (size - 1 - i));
+
+	return x;
+}
+
+// Every available kernel decodes the same symbols and line records, in both
+// byte orders and with counts that leave tails for the vector loops
+static void testBulkDecode()
+{
+	std::mt19937 random(1234);
+	std::vector<unsigned char> data(40 * 16);
+
+	for (unsigned char &byte : data)
+		byte = (unsigned char)random();
+
+	for (int isa = BulkDecode::ISA_SCALAR; isa <= BulkDecode::getIsa(); isa++)
+	{
+		for (bool swap : { false, true })
+		{
+			for (size_t count = 0; count <= 37; count++)
+			{
+				std::vector<Elf32_Word> name(count), value(count), size(count);
+				std::vector<unsigned char> info(count);
+				std::vector<Elf32_Half> shndx(count);
+				BulkDecode::SymbolColumns symbols = { name.data(), value.data(), size.data(), info.data(), shndx.data() };
+
+				BulkDecode::decodeSymbols(data.data(), count, swap, symbols, (BulkDecode::Isa)isa);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					const unsigned char *sym = data.data() + i * sizeof(Elf32_Sym);
+
+					if (!CHECK(name[i] == readBytes(sym, 4, swap) && value[i] == readBytes(sym + 4, 4, swap) &&
+						size[i] == readBytes(sym + 8, 4, swap) && info[i] == sym[12] && shndx[i] == readBytes(sym + 14, 2, swap)))
+					{
+						std::cerr << "\tsymbol " << i << " of " << count << ", kernel " << isa << ", swap " << swap << std::endl;
+						break;
+					}
+				}
+
+				// The records end exactly at the end of the readable bytes, and then with some to spare
+				for (size_t available : { count * BulkDecode::LINE_RECORD_SIZE, data.size() })
+				{
+					std::vector<int> lineNumber(count), addressOffset(count);
+					std::vector<short> charOffset(count);
+					BulkDecode::LineColumns lines = { lineNumber.data(), charOffset.data(), addressOffset.data() };
+
+					BulkDecode::decodeLineRecords(data.data(), count, available, swap, lines, (BulkDecode::Isa)isa);
+
+					for (size_t i = 0; i < count; i++)
+					{
+						const unsigned char *rec = data.data() + i * BulkDecode::LINE_RECORD_SIZE;
+
+						if (!CHECK(lineNumber[i] == (int)readBytes(rec, 4, swap) && charOffset[i] == (short)readBytes(rec + 4, 2, swap) &&
+							addressOffset[i] == (int)readBytes(rec + 6, 4, swap)))
+						{
+							std::cerr << "\tline record " << i << " of " << count << ", kernel " << isa << ", swap " << swap << std::endl;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Mangled names of both ABIs and what they demangle to, nullptr for none
+static const struct
+{
+	const char *mangled;
+	const char *demangled;
+} g_demangleCases[] =
+{
+	// Free and member functions
+	{ "Init__Fv", "Init()" },
+	{ "Update__6zSceneFf", "zScene::Update(float)" },
+	{ "Update__6zScenef", "zScene::Update(float)" },
+	{ "Load__6zSceneFPCcUiRi", "zScene::Load(const char*, unsigned int, int&)" },
+	{ "Set__6zSceneFPCPc", "zScene::Set(char* const*)" },
+	{ "Print__FPCce", "Print(const char*, ...)" },
+	{ "get_id__5xBase", "xBase::get_id()" },
+	{ "Find__1A__1BFv", "B::Find__1A()" },
+
+	// Q-scopes
+	{ "Reset__Q23Foo3BarFv", "Foo::Bar::Reset()" },
+	{ "Reset__Q23Foo3Bar", "Foo::Bar::Reset()" },
+	{ "Copy__FRCQ23Foo3Bar", "Copy(const Foo::Bar&)" },
+	{ "Get__Q_12_1A1B1C1D1E1F1G1H1I1J1K1LFv", "A::B::C::D::E::F::G::H::I::J::K::L::Get()" },
+
+	// Templates, with type and value arguments
+	{ "Get__t5Array2Zfi4Fi", "Array<float, 4>::Get(int)" },
+	{ "Push__t6Vector1Zt6Vector1ZiFRCi", "Vector<Vector<int> >::Push(const int&)" },
+	{ "Set__t5Range2ZiimUiFv", nullptr },
+	{ "Offset__t5Delta1im3Fv", "Delta<-3>::Offset()" },
+	{ "__ct__t6Vector1ZiFv", "Vector<int>::Vector()" },
+
+	// GCC 2.x back references: T<index> and N<count><index>, with the class first
+	{ "Set__6zScenefT1", "zScene::Set(float, float)" },
+	{ "Set__6zScenefN21", "zScene::Set(float, float, float)" },
+	{ "Swap__6zSceneR6zSceneT0", "zScene::Swap(zScene&, zScene)" },
+	{ "Blend__6zScenedN_11_1", "zScene::Blend(double, double, double, double, double, double, double, double, double, double, double, double)" },
+	{ "Set__6zSceneT2", nullptr },
+
+	// Const member functions
+	{ "Get__6zSceneCFv", "zScene::Get() const" },
+	{ "Get__C6zScene", "zScene::Get() const" },
+	{ "Size__CQ23Foo3Bar", "Foo::Bar::Size() const" },
+
+	// Operators
+	{ "__pl__6zSceneFRC6zScene", "zScene::operator+(const zScene&)" },
+	{ "__apl__6zSceneFi", "zScene::operator+=(int)" },
+	{ "__amu__6zSceneFf", "zScene::operator*=(float)" },
+	{ "__aml__6zScenef", "zScene::operator*=(float)" },
+	{ "__vc__6zSceneFi", "zScene::operator[](int)" },
+	{ "__nw__FUi", "operator new(unsigned int)" },
+	{ "__dla__FPv", "operator delete[](void*)" },
+	{ "__opi__6zSceneFv", "zScene::operator int()" },
+	{ "__opPC6zScene__6zSceneCFv", "zScene::operator const zScene*() const" },
+
+	// Constructors and destructors
+	{ "__ct__6zSceneFv", "zScene::zScene()" },
+	{ "__dt__6zSceneFv", "zScene::~zScene()" },
+	{ "__6zScenei", "zScene::zScene(int)" },
+	{ "_$_6zScene", "zScene::~zScene()" },
+	{ "_._Q23Foo3Bar", "Foo::Bar::~Bar()" },
+	{ "__ct__Fv", nullptr },
+
+	// Arrays
+	{ "Fill__FPA4_f", "Fill(float (*)[4])" },
+	{ "Fill__FRA4_i", "Fill(int (&)[4])" },
+	{ "Fill__FPA2_A3_i", "Fill(int (*)[2][3])" },
+	{ "Fill__FPA2_PFv_v", "Fill(void (*(*)[2])())" },
+
+	// Pointers to functions and to members
+	{ "Call__FPFi_v", "Call(void (*)(int))" },
+	{ "Call__FPFPFc_i_v", "Call(void (*)(int (*)(char)))" },
+	{ "Call__FPFi_PFc_i", "Call(int (*(*)(int))(char))" },
+	{ "bar__FM6zScenei", "bar(int zScene::*)" },
+	{ "bar__FM6zSceneFv_v", "bar(void (zScene::*)())" },
+	{ "bar__FM6zSceneCFi_v", "bar(void (zScene::*)(int) const)" },
+	{ "bar__FM6zScenePFv_v", "bar(void (* zScene::*)())" },
+	{ "bar__FM6zSceneA4_i", "bar(int (zScene::*)[4])" },
+	{ "bar__FPM6zSceneFv_v", "bar(void (zScene::**)())" },
+
+	// Virtual tables
+	{ "__vt__6zScene", "vtable for zScene" },
+	{ "__vt__Q23Foo3Bar", "vtable for Foo::Bar" },
+	{ "_vt$6zScene", "vtable for zScene" },
+	{ "_vt.t6Vector1Zi", "vtable for Vector<int>" },
+
+	// Not mangled
+	{ "main", nullptr },
+	{ "Update__", nullptr },
+	{ "Update__6zSceneFx7", nullptr },
+	{ "Update__99zScene", nullptr },
+};
+
+static void testDemangle()
+{
+	Demangler demangler;
+
+	// Twice, the second time from the memoized results
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (auto &test : g_demangleCases)
+		{
+			const Demangler::Result *result = demangler.demangle(test.mangled);
+			std::string demangled = result ? result->toString() : "(null)";
+
+			if (!CHECK(demangled == (test.demangled ? test.demangled : "(null)")))
+				std::cerr << "\t" << test.mangled << " demangled to " << demangled << std::endl;
+		}
+	}
+
+	const Demangler::Result *vtable = demangler.demangle("__vt__6zScene");
+	CHECK(vtable && vtable->kind == Demangler::Result::VTABLE && vtable->getOwner() == "zScene");
+
+	const Demangler::Result *method = demangler.demangle("Get__6zSceneCFv");
+	CHECK(method && method->kind == Demangler::Result::FUNCTION && method->isConst && method->name == "Get");
+}
+
+static const struct
+{
+	const char *name;
+	void (*run)();
+} g_tests[] =
+{
+	{ "forward_this_reference", testForwardThisReference },
+	{ "static_method_owner", testStaticMethodOwner },
+	{ "cross_unit_reference", testCrossUnitReference },
+	{ "skipped_unit_reference", testSkippedUnitReference },
+	{ "stream", testStream },
+	{ "bulk_decode", testBulkDecode },
+	{ "demangle", testDemangle },
+};
+
+// Fixtures the command line tests run dwarf2cpp on
+static const struct
+{
+	const char *name;
+	void (*build)(Fixture::Builder &builder);
+} g_fixtures[] =
+{
+	{ "many_units", buildManyUnits },
+	{ "cross_unit", [](Fixture::Builder &builder) { buildCrossUnit(builder); } },
+	{ "cross_unit_changed", [](Fixture::Builder &builder) { buildCrossUnit(builder, "gScene2"); } },
+};
+
+// Usage: dwarf2cpp_tests [--write-fixture <name> <path>]
+int main(int argc, char *argv[])
+{
+	if (argc == 4 && strcmp(argv[1], "--write-fixture") == 0)
+	{
+		for (auto &fixture : g_fixtures)
+		{
+			if (strcmp(fixture.name, argv[2]) != 0)
+				continue;
+
+			Fixture::Builder builder;
+			fixture.build(builder);
+			return builder.write(argv[3]) ? 0 : 1;
+		}
+
+		std::cerr << "Unknown fixture " << argv[2] << std::endl;
+		return 1;
+	}
+
+	for (auto &test : g_tests)
+	{
+		int numFailed = g_numFailed;
+		test.run();
+		std::cout << ((g_numFailed == numFailed) ? "PASS " : "FAIL ") << test.name << std::endl;
+	}
+
+	return g_numFailed;
+}
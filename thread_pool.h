@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads running queued tasks in FIFO order. Tasks may
+// submit more tasks; wait() returns once the queue is empty and every task has
+// finished, including the ones submitted while waiting.
+class ThreadPool
+{
+public:
+	// numThreads 0 means one per hardware thread
+	ThreadPool(unsigned numThreads = 0)
+	{
+		m_busy = 0;
+		m_stopping = false;
+
+		if (numThreads == 0)
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned i = 0; i < numThreads; i++)
+			m_threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+
+		m_taskReady.notify_all();
+
+		for (std::thread &t : m_threads)
+			t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::move(task));
+		}
+
+		m_taskReady.notify_one();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_tasks.empty() && m_busy == 0; });
+	}
+
+	size_t size() const
+	{
+		return m_threads.size();
+	}
+
+private:
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	std::condition_variable m_idle;
+	size_t m_busy;
+	bool m_stopping;
+
+	void workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (true)
+		{
+			m_taskReady.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+			if (m_tasks.empty())
+				return;
+
+			std::function<void()> task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_busy++;
+
+			lock.unlock();
+			task();
+			lock.lock();
+
+			m_busy--;
+
+			if (m_tasks.empty() && m_busy == 0)
+				m_idle.notify_all();
+		}
+	}
+};
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define DWARF2CPP_HAS_IO_URING 1
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Writes whole files through one io_uring, so the openat, write and close
+// calls of many files are submitted and completed in batches of a few system
+// calls. Up to `maxInFlight` files are open at a time; each one moves on to
+// its next operation as the previous one completes. The ring is driven with
+// raw system calls, so no library is needed.
+//
+// Existing files are unlinked first, so a file hard linked to others gets a
+// new inode instead of changing them as well.
+//
+// If the kernel doesn't support io_uring, or it is blocked, isAvailable()
+// returns false and the caller should write files another way. Parent
+// directories must exist before a file is added; the caller creates them with
+// ordinary system calls, since io_uring has no mkdir before Linux 5.15.
+class UringWriter
+{
+public:
+	UringWriter(unsigned maxInFlight = 256)
+	{
+		m_numFailed = 0;
+		m_available = false;
+
+#ifdef DWARF2CPP_HAS_IO_URING
+		m_ringFd = -1;
+		m_canUnlink = false;
+		m_sqRing = m_cqRing = MAP_FAILED;
+		m_sqes = (io_uring_sqe*)MAP_FAILED;
+		m_toSubmit = 0;
+
+		m_available = setup(maxInFlight);
+
+		if (!m_available)
+			return;
+
+		m_files.resize(maxInFlight);
+
+		for (unsigned i = 0; i < maxInFlight; i++)
+			m_freeSlots.push_back(maxInFlight - 1 - i);
+#else
+		(void)maxInFlight;
+#endif
+	}
+
+	~UringWriter()
+	{
+#ifdef DWARF2CPP_HAS_IO_URING
+		if (m_available)
+			finish();
+
+		if (m_sqes != MAP_FAILED)
+			munmap(m_sqes, m_sqesSize);
+
+		if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+			munmap(m_cqRing, m_cqRingSize);
+
+		if (m_sqRing != MAP_FAILED)
+			munmap(m_sqRing, m_sqRingSize);
+
+		if (m_ringFd >= 0)
+			close(m_ringFd);
+#endif
+	}
+
+	UringWriter(const UringWriter&) = delete;
+	UringWriter& operator=(const UringWriter&) = delete;
+
+	bool isAvailable() const
+	{
+		return m_available;
+	}
+
+	// Queues a file to be replaced or created and written. Waits for earlier
+	// files to complete while too many are in flight.
+	void addFile(const std::string &path, std::string contents)
+	{
+#ifdef DWARF2CPP_HAS_IO_URING
+		while (m_available && m_freeSlots.empty())
+			run(1);
+
+		// The ring broke down
+		if (!m_available)
+		{
+			addFailure(path);
+			return;
+		}
+
+		unsigned slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+
+		File &file = m_files[slot];
+		file.path = path;
+		file.contents = std::move(contents);
+		file.fd = -1;
+		file.written = 0;
+		file.failed = false;
+
+		if (!m_canUnlink)
+		{
+			unlink(file.path.c_str());
+			queueOpen(slot);
+			return;
+		}
+
+		file.state = UNLINKING;
+
+		io_uring_sqe *sqe = getSqe();
+		sqe->opcode = OP_UNLINKAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uint64_t)(uintptr_t)file.path.c_str();
+		sqe->user_data = slot;
+#else
+		(void)path;
+		(void)contents;
+#endif
+	}
+
+	// Waits for every queued file. Returns false if any of them couldn't be
+	// written; getFailedPaths() tells which.
+	bool finish()
+	{
+#ifdef DWARF2CPP_HAS_IO_URING
+		while (m_available && m_freeSlots.size() < m_files.size())
+			run(1);
+#endif
+		return m_numFailed == 0;
+	}
+
+	// The first few files that couldn't be written
+	const std::vector<std::string>& getFailedPaths() const
+	{
+		return m_failedPaths;
+	}
+
+	size_t getNumFailed() const
+	{
+		return m_numFailed;
+	}
+
+private:
+	bool m_available;
+	size_t m_numFailed;
+	std::vector<std::string> m_failedPaths;
+
+#ifdef DWARF2CPP_HAS_IO_URING
+	enum State { UNLINKING, OPENING, WRITING, CLOSING };
+
+	// IORING_OP_UNLINKAT, which needs Linux 5.11 and is missing from older headers
+	static const unsigned char OP_UNLINKAT = 36;
+
+	struct File
+	{
+		std::string path;
+		std::string contents;
+		int fd;
+		size_t written;
+		bool failed;
+		State state;
+	};
+
+	std::vector<File> m_files; // Indexed by slot, which is the user_data of its operation
+	std::vector<unsigned> m_freeSlots;
+
+	int m_ringFd;
+	bool m_canUnlink; // Whether the ring can unlink files, or addFile() does it
+	void *m_sqRing;
+	void *m_cqRing;
+	io_uring_sqe *m_sqes;
+	size_t m_sqRingSize;
+	size_t m_cqRingSize;
+	size_t m_sqesSize;
+
+	unsigned *m_sqHead;
+	unsigned *m_sqTail;
+	unsigned m_sqMask;
+	unsigned *m_sqArray;
+	unsigned *m_cqHead;
+	unsigned *m_cqTail;
+	unsigned m_cqMask;
+	io_uring_cqe *m_cqes;
+
+	unsigned m_toSubmit; // SQEs filled in since the last io_uring_enter
+
+	bool setup(unsigned entries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		m_ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+		if (m_ringFd < 0)
+			return false;
+
+		// Every file has one operation in flight, so the rings never overflow
+		if (params.sq_entries < entries || params.cq_entries < entries)
+			return false;
+
+		m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+		if (singleMmap)
+			m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+		m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+
+		if (m_sqRing == MAP_FAILED)
+			return false;
+
+		if (singleMmap)
+			m_cqRing = m_sqRing;
+		else
+			m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+
+		if (m_cqRing == MAP_FAILED)
+			return false;
+
+		m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+
+		if (m_sqes == MAP_FAILED)
+			return false;
+
+		char *sq = (char*)m_sqRing;
+		char *cq = (char*)m_cqRing;
+
+		m_sqHead = (unsigned*)(sq + params.sq_off.head);
+		m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+		m_sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+		m_sqArray = (unsigned*)(sq + params.sq_off.array);
+		m_cqHead = (unsigned*)(cq + params.cq_off.head);
+		m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+		m_cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+		m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		return supportsOperations();
+	}
+
+	// openat and close need Linux 5.6; older kernels may have a ring without them
+	bool supportsOperations()
+	{
+		const unsigned numOps = 64;
+		std::vector<char> buffer(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op), 0);
+		io_uring_probe *probe = (io_uring_probe*)buffer.data();
+
+		if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PROBE, probe, numOps) < 0)
+			return false;
+
+		auto supports = [probe](int op) {
+			return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+		};
+
+		for (int op : { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE })
+		{
+			if (!supports(op))
+				return false;
+		}
+
+		m_canUnlink = supports(OP_UNLINKAT);
+		return true;
+	}
+
+	// Queues the creation of a file whose path is free now
+	void queueOpen(unsigned slot)
+	{
+		File &file = m_files[slot];
+		file.state = OPENING;
+
+		io_uring_sqe *sqe = getSqe();
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uint64_t)(uintptr_t)file.path.c_str();
+		sqe->len = 0666;
+		sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		sqe->user_data = slot;
+	}
+
+	// A cleared SQE at the tail of the submission queue. There is always room,
+	// since there are as many entries as slots.
+	io_uring_sqe* getSqe()
+	{
+		unsigned tail = *m_sqTail;
+		unsigned index = tail & m_sqMask;
+		io_uring_sqe *sqe = &m_sqes[index];
+
+		memset(sqe, 0, sizeof(*sqe));
+		m_sqArray[index] = index;
+		__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+		m_toSubmit++;
+
+		return sqe;
+	}
+
+	// Submits the queued operations, waits for at least `minComplete` of
+	// them and handles every completion there is
+	void run(unsigned minComplete)
+	{
+		int result = (int)syscall(__NR_io_uring_enter, m_ringFd, m_toSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+		if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			// The ring is broken; give up on everything in flight
+			for (unsigned slot = 0; slot < m_files.size(); slot++)
+			{
+				if (std::find(m_freeSlots.begin(), m_freeSlots.end(), slot) == m_freeSlots.end())
+					fail(slot);
+			}
+
+			m_available = false;
+			return;
+		}
+
+		if (result > 0)
+			m_toSubmit -= std::min<unsigned>(m_toSubmit, (unsigned)result);
+
+		unsigned head = *m_cqHead;
+		unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++)
+		{
+			io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+			complete((unsigned)cqe.user_data, cqe.res);
+		}
+
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	// Queues the next operation of a file whose last one finished with `res`
+	void complete(unsigned slot, int res)
+	{
+		File &file = m_files[slot];
+
+		switch (file.state)
+		{
+		case UNLINKING:
+			if (res < 0 && res != -ENOENT)
+				fail(slot);
+			else
+				queueOpen(slot);
+
+			return;
+		case OPENING:
+			if (res < 0)
+			{
+				fail(slot);
+				return;
+			}
+
+			file.fd = res;
+			file.state = WRITING;
+			break;
+		case WRITING:
+			if (res == -EINTR || res == -EAGAIN)
+				break;
+
+			if (res <= 0)
+				file.failed = true;
+			else
+				file.written += res;
+
+			break;
+		case CLOSING:
+			// The descriptor is released even if close reports an error
+			file.fd = -1;
+
+			if (res < 0)
+				file.failed = true;
+
+			if (file.failed)
+				fail(slot);
+			else
+				release(slot);
+
+			return;
+		}
+
+		io_uring_sqe *sqe = getSqe();
+		sqe->fd = file.fd;
+		sqe->user_data = slot;
+
+		if (!file.failed && file.written < file.contents.size())
+		{
+			// Short writes continue where they stopped
+			const size_t maxWrite = 1 << 30;
+
+			sqe->opcode = IORING_OP_WRITE;
+			sqe->addr = (uint64_t)(uintptr_t)(file.contents.data() + file.written);
+			sqe->len = (unsigned)std::min(file.contents.size() - file.written, maxWrite);
+			sqe->off = file.written;
+		}
+		else
+		{
+			sqe->opcode = IORING_OP_CLOSE;
+			file.state = CLOSING;
+		}
+	}
+
+	// Gives up on a file, closing it if it was opened and not closed yet
+	void fail(unsigned slot)
+	{
+		File &file = m_files[slot];
+
+		if (file.fd >= 0)
+		{
+			close(file.fd);
+			file.fd = -1;
+		}
+
+		addFailure(file.path);
+		release(slot);
+	}
+
+	void addFailure(const std::string &path)
+	{
+		const size_t maxFailedPaths = 16;
+
+		if (m_failedPaths.size() < maxFailedPaths)
+			m_failedPaths.push_back(path);
+
+		m_numFailed++;
+	}
+
+	void release(unsigned slot)
+	{
+		File &file = m_files[slot];
+
+		file.path.clear();
+		std::string().swap(file.contents);
+		m_freeSlots.push_back(slot);
+	}
+#endif
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// A FIFO queue between two threads holding at most `capacity` items. push()
+// waits while the queue is full and pop() while it is empty, so a fast
+// producer can't get more than `capacity` items ahead of its consumer.
+// After close(), pushes are refused and pops drain what is left.
+template<class T>
+class WorkQueue
+{
+public:
+	WorkQueue(size_t capacity)
+	{
+		m_capacity = capacity;
+		m_closed = false;
+	}
+
+	WorkQueue(const WorkQueue&) = delete;
+	WorkQueue& operator=(const WorkQueue&) = delete;
+
+	// Returns false if the queue was closed before there was room
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+
+		if (m_closed)
+			return false;
+
+		m_items.push_back(std::move(item));
+		lock.unlock();
+
+		m_notEmpty.notify_one();
+		return true;
+	}
+
+	// Returns false once the queue is closed and empty
+	bool pop(T *item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+
+		if (m_items.empty())
+			return false;
+
+		*item = std::move(m_items.front());
+		m_items.pop_front();
+		lock.unlock();
+
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+
+		m_notFull.notify_all();
+		m_notEmpty.notify_all();
+	}
+
+private:
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed;
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+};